@@ -12,9 +12,18 @@
  */
 #include "LD2410.h"
 
+#if LD2410_LOG_LEVEL > LD2410_LOG_NONE
+#define LD2410_LOG(level, event, arg8, arg16) do { if ((level) <= LD2410_LOG_LEVEL) { log_(event, arg8, arg16); } } while (0)
+#else
+#define LD2410_LOG(level, event, arg8, arg16) do { } while (0)
+#endif
+
+static const uint8_t LD2410_DATA_HEADER[4] = { 0xF4, 0xF3, 0xF2, 0xF1 };
+static const uint8_t LD2410_DATA_FOOTER[4] = { 0xF8, 0xF7, 0xF6, 0xF5 };
+static const uint8_t LD2410_COMMAND_HEADER[4] = { 0xFD, 0xFC, 0xFB, 0xFA };
+static const uint8_t LD2410_COMMAND_FOOTER[4] = { 0x04, 0x03, 0x02, 0x01 };
 
-LD2410::LD2410(HardwareSerial& serialPort): serial(serialPort) {
-	serial = serialPort;
+LD2410::LD2410(Stream& serialPort): serial(serialPort) {
 }
 
 LD2410::~LD2410() {
@@ -73,6 +82,99 @@ void LD2410::debug(Stream& terminalStream) {
 #endif
 }
 
+uint16_t LD2410::drainLog(uint16_t maxRecords) {
+	uint16_t drained = 0;
+#if LD2410_LOG_LEVEL > LD2410_LOG_NONE
+	LD2410LogRecord record;
+	uint32_t dropped = logBuffer.takeDropped();
+	if (dropped > 0 && debugSerial != nullptr)
+	{
+		debugSerial->print(F("\nLD2410 log dropped "));
+		debugSerial->print(dropped);
+	}
+	while (drained < maxRecords && logBuffer.pop(record))
+	{
+		drained++;
+		if (debugSerial != nullptr)
+		{
+			print_log_record_(record);
+		}
+	}
+#endif
+	return drained;
+}
+
+#if LD2410_LOG_LEVEL > LD2410_LOG_NONE
+void LD2410::log_(LD2410LogEvent event, uint8_t arg8, uint16_t arg16) {
+	LD2410LogRecord record = { micros(), event, arg8, arg16 };
+	logBuffer.push(record);
+}
+
+void LD2410::print_log_record_(const LD2410LogRecord& record) {
+	debugSerial->print(F("\n["));
+	debugSerial->print(record.timestamp);
+	debugSerial->print(F("us] LD2410 "));
+	switch (record.event)
+	{
+	case LD2410_LOG_FRAME_OVERRUN:
+		debugSerial->print(record.arg8 ? F("ACK") : F("data"));
+		debugSerial->print(F(" frame overran, length "));
+		debugSerial->print(record.arg16);
+		break;
+	case LD2410_LOG_FRAME_LENGTH_MISMATCH:
+		debugSerial->print(F("frame length unexpected: "));
+		debugSerial->print(record.arg8);
+		debugSerial->print(F(" not "));
+		debugSerial->print(record.arg16);
+		break;
+	case LD2410_LOG_UNKNOWN_FRAME:
+		debugSerial->print(F("unknown frame type 0x"));
+		debugSerial->print(record.arg8, HEX);
+		debugSerial->print(F(" length "));
+		debugSerial->print(record.arg16);
+		break;
+	case LD2410_LOG_UNKNOWN_ACK:
+		debugSerial->print(F("unknown ACK 0x"));
+		debugSerial->print(record.arg8, HEX);
+		debugSerial->print(F(" length "));
+		debugSerial->print(record.arg16);
+		break;
+	case LD2410_LOG_COMMAND_FAILED:
+		debugSerial->print(F("command 0x"));
+		debugSerial->print(record.arg8, HEX);
+		debugSerial->print(record.arg16 == LD2410_COMMAND_TIMED_OUT ? F(" timed out") : F(" failed"));
+		break;
+	case LD2410_LOG_COMMAND_SENT:
+		debugSerial->print(F("sent command 0x"));
+		debugSerial->print(record.arg8, HEX);
+		break;
+	case LD2410_LOG_ACK:
+		debugSerial->print(F("ACK for command 0x"));
+		debugSerial->print(record.arg8, HEX);
+		debugSerial->print(record.arg16 ? F(": OK") : F(": failed"));
+		break;
+	case LD2410_LOG_CONFIGURATION:
+		debugSerial->print(F("max gate distance "));
+		debugSerial->print(record.arg8);
+		debugSerial->print(F(", sensor idle timeout "));
+		debugSerial->print(record.arg16);
+		debugSerial->print('s');
+		break;
+	case LD2410_LOG_DATA_FRAME:
+	case LD2410_LOG_ENGINEERING_FRAME:
+		debugSerial->print(record.event == LD2410_LOG_DATA_FRAME ? F("normal data, target type ") : F("engineering data, target type "));
+		debugSerial->print(record.arg8);
+		debugSerial->print(record.event == LD2410_LOG_DATA_FRAME ? F(" at ") : F(" gates "));
+		debugSerial->print(record.arg16);
+		break;
+	default:
+		debugSerial->print(F("event "));
+		debugSerial->print(record.event);
+		break;
+	}
+}
+#endif
+
 bool LD2410::isConnected() {
 	if (millis() - uartLastPacket < uartTimeout)	//Use the last reading
 	{
@@ -85,8 +187,10 @@ bool LD2410::isConnected() {
 	return false;
 }
 
-bool LD2410::read() {
-	return read_frame_();
+uint16_t LD2410::read() {
+	uint16_t framesDecoded = read_frame_();
+	service_commands_();
+	return framesDecoded;
 }
 
 bool LD2410::presenceDetected() {
@@ -141,222 +245,145 @@ uint8_t LD2410::getMovingTargetEnergy() {
 	//return 0;
 }
 
-bool LD2410::read_frame_() {
-	bool isDataFrameStarted = false;
-	if (serial.available())
+bool LD2410::engineeringDataAvailable() {
+	return isEngineeringFrame;
+}
+
+const LD2410EngineeringData& LD2410::getEngineeringData() {
+	return engineeringData;
+}
+
+uint8_t LD2410::getMovingGateEnergy(uint8_t gate) {
+	if (gate < engineeringData.movingGates)
+	{
+		return engineeringData.movingEnergy[gate];
+	}
+	return 0;
+}
+
+uint8_t LD2410::getStationaryGateEnergy(uint8_t gate) {
+	if (gate < engineeringData.stationaryGates)
+	{
+		return engineeringData.stationaryEnergy[gate];
+	}
+	return 0;
+}
+
+uint16_t LD2410::read_frame_() {
+	uint16_t framesDecoded = 0;
+	int bytesPending = serial.available();	//Drain only what is already buffered so the call stays bounded
+	while (bytesPending-- > 0)
 	{
-		if (isDataFrameStarted == false)
+		int byte_read_ = serial.read();
+		if (byte_read_ < 0)
 		{
-			uint8_t byte_read_ = serial.read();
-			if (byte_read_ == 0xF4)
-			{
-#ifdef LD2410_DEBUG_DATA
-				if (debugSerial != nullptr)
-				{
-					debugSerial->print(F("\nRcvd : 00 "));
-				}
-#endif
-				dataFrame[dataFramePosition++] = byte_read_;
-				isDataFrameStarted = true;
-				isAckFrame = false;
-			}
-			else if (byte_read_ == 0xFD)
-			{
-#ifdef LD2410_DEBUG_COMMANDS
-				if (debugSerial != nullptr)
-				{
-					debugSerial->print(F("\nRcvd : 00 "));
-				}
-#endif
-				dataFrame[dataFramePosition++] = byte_read_;
-				isDataFrameStarted = true;
-				isAckFrame = true;
-			}
+			break;
 		}
-		else
+		if (append_byte_((uint8_t)byte_read_))
 		{
-			if (dataFramePosition < LD2410_MAX_FRAME_LENGTH)
+			if (isAckFrame)
 			{
-#ifdef LD2410_DEBUG_DATA
-				if (debugSerial != nullptr && isAckFrame == false)
-				{
-					if (dataFramePosition < 0x10)
-					{
-						debugSerial->print('0');
-					}
-					debugSerial->print(dataFramePosition, HEX);
-					debugSerial->print(' ');
-				}
-#endif
-#ifdef LD2410_DEBUG_COMMANDS
-				if (debugSerial != nullptr && isAckFrame == true)
+				bool parsed = parse_command_frame_();
+				if (parsed)
 				{
-					if (dataFramePosition < 0x10)
-					{
-						debugSerial->print('0');
-					}
-					debugSerial->print(dataFramePosition, HEX);
-					debugSerial->print(' ');
-				}
-#endif
-				dataFrame[dataFramePosition++] = serial.read();
-				if (dataFramePosition > 7)	//Can check for start and end
-				{
-					if (dataFrame[0] == 0xF4 &&	//Data frame end state
-						dataFrame[1] == 0xF3 &&
-						dataFrame[2] == 0xF2 &&
-						dataFrame[3] == 0xF1 &&
-						dataFrame[dataFramePosition - 4] == 0xF8 &&
-						dataFrame[dataFramePosition - 3] == 0xF7 &&
-						dataFrame[dataFramePosition - 2] == 0xF6 &&
-						dataFrame[dataFramePosition - 1] == 0xF5
-						)
-					{
-						if (parse_data_frame_())
-						{
-#ifdef LD2410_DEBUG_DATA
-							if (debugSerial != nullptr)
-							{
-								debugSerial->print(F("parsed data OK"));
-							}
-#endif
-							isDataFrameStarted = false;
-							dataFramePosition = 0;
-							return true;
-						}
-						else
-						{
-#ifdef LD2410_DEBUG_DATA
-							if (debugSerial != nullptr)
-							{
-								debugSerial->print(F("failed to parse data"));
-							}
-#endif
-							isDataFrameStarted = false;
-							dataFramePosition = 0;
-						}
-					}
-					else if (dataFrame[0] == 0xFD &&	//Command frame end state
-						dataFrame[1] == 0xFC &&
-						dataFrame[2] == 0xFB &&
-						dataFrame[3] == 0xFA &&
-						dataFrame[dataFramePosition - 4] == 0x04 &&
-						dataFrame[dataFramePosition - 3] == 0x03 &&
-						dataFrame[dataFramePosition - 2] == 0x02 &&
-						dataFrame[dataFramePosition - 1] == 0x01
-						)
-					{
-						if (parse_command_frame_())
-						{
-#ifdef LD2410_DEBUG_COMMANDS
-							if (debugSerial != nullptr)
-							{
-								debugSerial->print(F("parsed command OK"));
-							}
-#endif
-							isDataFrameStarted = false;
-							dataFramePosition = 0;
-							return true;
-						}
-						else
-						{
-#ifdef LD2410_DEBUG_COMMANDS
-							if (debugSerial != nullptr)
-							{
-								debugSerial->print(F("failed to parse command"));
-							}
-#endif
-							isDataFrameStarted = false;
-							dataFramePosition = 0;
-						}
-					}
+					framesDecoded++;
 				}
+				handle_command_ack_(uartLatestAck, parsed);
 			}
 			else
 			{
-#if defined(LD2410_DEBUG_DATA) || defined(LD2410_DEBUG_COMMANDS)
-				if (debugSerial != nullptr)
+				if (parse_data_frame_())
 				{
-					debugSerial->print(F("\nLD2410 frame overran"));
+					framesDecoded++;
 				}
-#endif
-				isDataFrameStarted = false;
-				dataFramePosition = 0;
 			}
+			dataFramePosition = 0;
 		}
 	}
-	return false;
+	return framesDecoded;
 }
 
-void LD2410::print_frame_() {
-	if (debugSerial != nullptr)
+bool LD2410::append_byte_(uint8_t byte_read_) {
+	if (dataFramePosition == 0)	//Waiting for the first header byte
 	{
-		if (isAckFrame == true)
+		if (byte_read_ == LD2410_DATA_HEADER[0])
+		{
+			isAckFrame = false;
+		}
+		else if (byte_read_ == LD2410_COMMAND_HEADER[0])
 		{
-			debugSerial->print(F("\nCmnd : "));
+			isAckFrame = true;
 		}
 		else
 		{
-			debugSerial->print(F("\nData : "));
+			return false;
 		}
-		for (uint8_t i = 0; i < dataFramePosition; i++)
+		dataFrame[dataFramePosition++] = byte_read_;
+		return false;
+	}
+	dataFrame[dataFramePosition++] = byte_read_;
+	if (dataFramePosition < 5)	//Rest of the header
+	{
+		const uint8_t* header = isAckFrame ? LD2410_COMMAND_HEADER : LD2410_DATA_HEADER;
+		if (byte_read_ != header[dataFramePosition - 1])
 		{
-			if (dataFrame[i] < 0x10)
-			{
-				debugSerial->print('0');
-			}
-			debugSerial->print(dataFrame[i], HEX);
-			debugSerial->print(' ');
+			dataFramePosition = 0;
+			return append_byte_(byte_read_);	//The mismatched byte may start a new frame
+		}
+	}
+	else if (dataFramePosition == 6)	//Intra frame length is complete, so the frame end is known
+	{
+		dataFrameLength = dataFrame[4] + (dataFrame[5] << 8) + 10;
+		if (dataFrameLength > LD2410_MAX_FRAME_LENGTH)
+		{
+			LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_FRAME_OVERRUN, isAckFrame, dataFrameLength);
+			dataFramePosition = 0;
+		}
+	}
+	else if (dataFramePosition == dataFrameLength)	//Frame complete, check the footer
+	{
+		const uint8_t* footer = isAckFrame ? LD2410_COMMAND_FOOTER : LD2410_DATA_FOOTER;
+		if (dataFrame[dataFrameLength - 4] == footer[0] &&
+			dataFrame[dataFrameLength - 3] == footer[1] &&
+			dataFrame[dataFrameLength - 2] == footer[2] &&
+			dataFrame[dataFrameLength - 1] == footer[3]
+			)
+		{
+			return true;
 		}
+		dataFramePosition = 0;
 	}
+	return false;
 }
 
 bool LD2410::parse_data_frame_() {
 	uint16_t intraDataFrameLength = dataFrame[4] + (dataFrame[5] << 8);
 	if (dataFramePosition == intraDataFrameLength + 10)
 	{
-#ifdef LD2410_DEBUG_DATA
-		if (debugSerial != nullptr && isAckFrame == false)
+		if (dataFrame[6] == 0x01 && dataFrame[7] == 0xAA && dataFrame[dataFramePosition - 6] == 0x55 && dataFrame[dataFramePosition - 5] == 0x00)	//Engineering mode data
 		{
-			print_frame_();
-		}
-#endif
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr && isAckFrame == true)
-		{
-			print_frame_();
-		}
-#endif
-		if (dataFrame[6] == 0x01 && dataFrame[7] == 0xAA)	//Engineering mode data
-		{
-			targetType = dataFrame[8];
-#ifdef LD2410_DEBUG_PARSE
-			if (debugSerial != nullptr)
+			uint8_t movingGates = dataFrame[17] + 1;	//Frame reports the highest gate, not the count
+			uint8_t stationaryGates = dataFrame[18] + 1;
+			if (movingGates > LD2410_MAX_GATES || stationaryGates > LD2410_MAX_GATES || 19 + movingGates + stationaryGates > dataFramePosition - 6)
 			{
-				debugSerial->print(F("\nEngineering data - "));
-				if (targetType == 0x00)
-				{
-					debugSerial->print(F("no target"));
-				}
-				else if (targetType == 0x01)
-				{
-					debugSerial->print(F("moving target:"));
-				}
-				else if (targetType == 0x02)
-				{
-					debugSerial->print(F("stationary target:"));
-				}
-				else if (targetType == 0x03)
-				{
-					debugSerial->print(F("moving & stationary targets:"));
-				}
+				LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_UNKNOWN_FRAME, dataFrame[6], intraDataFrameLength);
+				return false;
 			}
-#endif
-			/*
-			 *
-			 *	To-do support engineering mode
-			 *
-			 */
+			targetType = dataFrame[8];
+			movingTargetDistance = dataFrame[9] + (dataFrame[10] << 8);
+			movingTargetEnergy = dataFrame[11];
+			stationaryTargetDistance = dataFrame[12] + (dataFrame[13] << 8);
+			stationaryTargetEnergy = dataFrame[14];
+			detectionDistance = dataFrame[15];
+			engineeringData.movingGates = movingGates;
+			engineeringData.stationaryGates = stationaryGates;
+			memcpy(engineeringData.movingEnergy, &dataFrame[19], movingGates);
+			memcpy(engineeringData.stationaryEnergy, &dataFrame[19 + movingGates], stationaryGates);
+			LD2410_LOG(LD2410_LOG_DATA, LD2410_LOG_ENGINEERING_FRAME, targetType, movingGates);
+			uartLastPacket = millis();
+			engineeringData.lastUpdate = uartLastPacket;
+			isEngineeringFrame = true;
+			return true;
 		}
 		else if (intraDataFrameLength == 13 && dataFrame[6] == 0x02 && dataFrame[7] == 0xAA && dataFrame[17] == 0x55 && dataFrame[18] == 0x00)	//Normal target data
 		{
@@ -366,692 +393,599 @@ bool LD2410::parse_data_frame_() {
 			stationaryTargetDistance = dataFrame[12] + (dataFrame[13] << 8);
 			stationaryTargetEnergy = dataFrame[14];
 			detectionDistance = dataFrame[15];
-#ifdef LD2410_DEBUG_PARSE
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("\nNormal data - "));
-				if (targetType == 0x00)
-				{
-					debugSerial->print(F("no target"));
-				}
-				else if (targetType == 0x01)
-				{
-					debugSerial->print(F("moving target:"));
-				}
-				else if (targetType == 0x02)
-				{
-					debugSerial->print(F("stationary target:"));
-				}
-				else if (targetType == 0x03)
-				{
-					debugSerial->print(F("moving & stationary targets:"));
-				}
-				if (dataFrame[8] & 0x01)
-				{
-					debugSerial->print(F(" moving at "));
-					debugSerial->print(movingTargetDistance);
-					debugSerial->print(F("cm power "));
-					debugSerial->print(movingTargetEnergy);
-				}
-				if (dataFrame[8] & 0x02)
-				{
-					debugSerial->print(F(" stationary at "));
-					debugSerial->print(stationaryTargetDistance);
-					debugSerial->print(F("cm power "));
-					debugSerial->print(stationaryTargetEnergy);
-				}
-			}
-#endif
+			isEngineeringFrame = false;
+			LD2410_LOG(LD2410_LOG_DATA, LD2410_LOG_DATA_FRAME, targetType, targetType & 0x01 ? movingTargetDistance : stationaryTargetDistance);
 			uartLastPacket = millis();
 			return true;
 		}
 		else
 		{
-#ifdef LD2410_DEBUG_DATA
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("\nUnknown frame type"));
-			}
-#endif
-			print_frame_();
+			LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_UNKNOWN_FRAME, dataFrame[6], intraDataFrameLength);
 		}
 	}
 	else
 	{
-#ifdef LD2410_DEBUG_DATA
-		if (debugSerial != nullptr)
+		LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_FRAME_LENGTH_MISMATCH, dataFramePosition, intraDataFrameLength + 10);
+	}
+	return false;
+}
+
+/*
+ * ACK frames are dispatched through this table, indexed by ACK opcode, instead of testing each opcode in turn.
+ * The length is the intra frame length the ACK must have; the decoder, if any, runs once the ACK status is a success.
+ */
+constexpr LD2410::ack_decoder_ LD2410::ackDecoders[] = {
+	{ 0xFF, 8, &LD2410::decode_enter_configuration_ack_ },			//Enter configuration mode
+	{ 0xFE, 4, nullptr },											//Leave configuration mode
+	{ 0x60, 4, nullptr },											//Set max values
+	{ 0x61, 28, &LD2410::decode_configuration_ack_ },				//Current configuration
+	{ 0x62, 4, nullptr },											//Start engineering mode
+	{ 0x63, 4, nullptr },											//End engineering mode
+	{ 0x64, 4, nullptr },											//Set sensitivity values
+	{ 0xA0, 12, &LD2410::decode_firmware_version_ack_ },			//Firmware version
+	{ 0xA1, 4, nullptr },											//Set baud rate
+	{ 0xA2, 4, nullptr },											//Factory reset
+	{ 0xA3, 4, nullptr },											//Restart
+	{ 0xA5, 10, &LD2410::decode_mac_address_ack_ },				//MAC address
+	{ 0xAA, 4, nullptr },											//Set distance resolution
+	{ 0xAB, 6, &LD2410::decode_distance_resolution_ack_ }			//Distance resolution
+};
+
+constexpr uint8_t LD2410::ack_slot_(uint8_t ack) {
+	return (ack ^ (ack >> 4)) & (LD2410_ACK_INDEX_LENGTH - 1);	//Distinct for every ACK in the table
+}
+
+constexpr LD2410::ack_index_ LD2410::build_ack_index_() {
+	ack_index_ index = {};
+	for (uint8_t i = 0; i < sizeof(ackDecoders) / sizeof(ackDecoders[0]); i++)
+	{
+		if (index.entry[ack_slot_(ackDecoders[i].ack)] != 0)
 		{
-			debugSerial->print(F("\nFrame length unexpected: "));
-			debugSerial->print(dataFramePosition);
-			debugSerial->print(F(" not "));
-			debugSerial->print(intraDataFrameLength + 10);
+			index.collision = true;
 		}
-#endif
+		index.entry[ack_slot_(ackDecoders[i].ack)] = i + 1;
 	}
-	return false;
+	return index;
 }
 
+constexpr LD2410::ack_index_ LD2410::ackIndex = LD2410::build_ack_index_();
+
 bool LD2410::parse_command_frame_() {
+	static_assert(!ackIndex.collision, "Two LD2410 ACK opcodes share an index slot, change ack_slot_()");
 	uint16_t intraDataFrameLength = dataFrame[4] + (dataFrame[5] << 8);
-#ifdef LD2410_DEBUG_COMMANDS
-	if (debugSerial != nullptr)
-	{
-		print_frame_();
-		debugSerial->print(F("\nACK frame payload: "));
-		debugSerial->print(intraDataFrameLength);
-		debugSerial->print(F(" bytes"));
-	}
-#endif
 	uartLatestAck = dataFrame[6];
 	wasLastCommandSuccessful = (dataFrame[8] == 0x00 && dataFrame[9] == 0x00);
-	if (intraDataFrameLength == 8 && uartLatestAck == 0xFF)
+	uint8_t entry = ackIndex.entry[ack_slot_(uartLatestAck)];
+	if (entry == 0 || ackDecoders[entry - 1].ack != uartLatestAck || ackDecoders[entry - 1].length != intraDataFrameLength)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for entering configuration mode: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_UNKNOWN_ACK, uartLatestAck, intraDataFrameLength);
+		return false;
 	}
-	else if (intraDataFrameLength == 4 && uartLatestAck == 0xFE)
+	LD2410_LOG(LD2410_LOG_COMMANDS, LD2410_LOG_ACK, uartLatestAck, wasLastCommandSuccessful);
+	if (wasLastCommandSuccessful == false)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for leaving configuration mode: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		return false;
 	}
-	else if (intraDataFrameLength == 4 && uartLatestAck == 0x60)
+	uartLastPacket = millis();
+	void (LD2410::*decode)() = ackDecoders[entry - 1].decode;
+	if (decode != nullptr)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for setting max values: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		(this->*decode)();
 	}
-	else if (intraDataFrameLength == 28 && uartLatestAck == 0x61)
+	return true;
+}
+
+void LD2410::decode_enter_configuration_ack_() {
+	uint16_t bufferSize = dataFrame[12] + (dataFrame[13] << 8);	//After the protocol version
+	commandBufferSize = bufferSize > 0 ? bufferSize : LD2410_DEFAULT_COMMAND_BUFFER;
+}
+
+void LD2410::decode_configuration_ack_() {
+	max_gate = dataFrame[11];
+	max_moving_gate = dataFrame[12];
+	max_stationary_gate = dataFrame[13];
+	memcpy(motion_sensitivity, &dataFrame[14], LD2410_MAX_GATES);
+	memcpy(stationary_sensitivity, &dataFrame[23], LD2410_MAX_GATES);
+	sensor_idle_time = dataFrame[32];
+	sensor_idle_time += (dataFrame[33] << 8);
+	LD2410_LOG(LD2410_LOG_COMMANDS, LD2410_LOG_CONFIGURATION, max_gate, sensor_idle_time);
+}
+
+void LD2410::decode_firmware_version_ack_() {
+	firmware_major_version = dataFrame[13];
+	firmware_minor_version = dataFrame[12];
+	firmware_bugfix_version = dataFrame[14];
+	firmware_bugfix_version += dataFrame[15] << 8;
+	firmware_bugfix_version += dataFrame[16] << 16;
+	firmware_bugfix_version += dataFrame[17] << 24;
+}
+
+void LD2410::decode_mac_address_ack_() {
+	memcpy(mac_address, &dataFrame[10], sizeof(mac_address));
+}
+
+void LD2410::decode_distance_resolution_ack_() {
+	distance_resolution = dataFrame[10] + (dataFrame[11] << 8);
+}
+
+/*
+ * Command frames are built at compile time, so commands without parameters are written straight from flash
+ * and commands with parameters copy their template and patch the parameter bytes.
+ */
+template <uint8_t Command, uint8_t... Value>
+struct LD2410CommandFrame {
+	static constexpr uint8_t bytes[] = {
+		0xFD, 0xFC, 0xFB, 0xFA,						//Command preamble
+		(uint8_t)(sizeof...(Value) + 2), 0x00,		//Command word plus value
+		Command, 0x00,
+		Value...,
+		0x04, 0x03, 0x02, 0x01						//Command end
+	};
+	static_assert(sizeof(bytes) <= LD2410_MAX_COMMAND_FRAME_LENGTH, "LD2410 command frame too long");
+};
+
+typedef LD2410CommandFrame<0xFF, 0x01, 0x00> LD2410EnterConfigurationFrame;
+typedef LD2410CommandFrame<0xFE> LD2410LeaveConfigurationFrame;
+typedef LD2410CommandFrame<0x61> LD2410ReadConfigurationFrame;
+typedef LD2410CommandFrame<0x62> LD2410StartEngineeringModeFrame;
+typedef LD2410CommandFrame<0x63> LD2410EndEngineeringModeFrame;
+typedef LD2410CommandFrame<0xA0> LD2410FirmwareVersionFrame;
+typedef LD2410CommandFrame<0xA2> LD2410FactoryResetFrame;
+typedef LD2410CommandFrame<0xA3> LD2410RestartFrame;
+typedef LD2410CommandFrame<0xA5, 0x01, 0x00> LD2410MacAddressFrame;
+typedef LD2410CommandFrame<0xAB> LD2410DistanceResolutionFrame;
+typedef LD2410CommandFrame<0x60,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	//Moving gate command and value
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00,	//Stationary gate command and value
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00	//Inactivity timer command and value
+	> LD2410MaxValuesFrame;
+typedef LD2410CommandFrame<0x64,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	//Gate command and value
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00,	//Motion sensitivity command and value
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00	//Stationary sensitivity command and value
+	> LD2410GateSensitivityFrame;
+
+const uint8_t* LD2410Command::frame() const {
+	return constantFrame != nullptr ? constantFrame : encodedFrame;
+}
+
+uint8_t LD2410Command::command() const {
+	return frame()[6];
+}
+
+template <typename Frame>
+static void encode_command_(LD2410Command& command) {
+	command.constantFrame = Frame::bytes;
+	command.frameLength = sizeof(Frame::bytes);
+	command.status = LD2410_COMMAND_QUEUED;
+}
+
+template <typename Frame>
+static uint8_t* encode_parameters_(LD2410Command& command) {
+	memcpy(command.encodedFrame, Frame::bytes, sizeof(Frame::bytes));
+	command.constantFrame = nullptr;
+	command.frameLength = sizeof(Frame::bytes);
+	command.status = LD2410_COMMAND_QUEUED;
+	return command.encodedFrame;
+}
+
+static void encode_max_values_(LD2410Command& command, uint16_t moving, uint16_t stationary, uint16_t inactivityTimer) {
+	uint8_t* frame = encode_parameters_<LD2410MaxValuesFrame>(command);
+	frame[10] = moving & 0x00FF;
+	frame[11] = (moving & 0xFF00) >> 8;
+	frame[16] = stationary & 0x00FF;
+	frame[17] = (stationary & 0xFF00) >> 8;
+	frame[22] = inactivityTimer & 0x00FF;
+	frame[23] = (inactivityTimer & 0xFF00) >> 8;
+}
+
+static void encode_gate_sensitivity_threshold_(LD2410Command& command, uint8_t gate, uint8_t moving, uint8_t stationary) {
+	uint8_t* frame = encode_parameters_<LD2410GateSensitivityFrame>(command);
+	frame[10] = gate;
+	frame[16] = moving;
+	frame[22] = stationary;
+}
+
+bool LD2410ConfigurationBatch::setMaxValues(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer) {
+	if (commandCount == LD2410_MAX_BATCH_LENGTH)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for current configuration: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			max_gate = dataFrame[11];
-			max_moving_gate = dataFrame[12];
-			max_stationary_gate = dataFrame[13];
-			motion_sensitivity[0] = dataFrame[14];
-			motion_sensitivity[1] = dataFrame[15];
-			motion_sensitivity[2] = dataFrame[16];
-			motion_sensitivity[3] = dataFrame[17];
-			motion_sensitivity[4] = dataFrame[18];
-			motion_sensitivity[5] = dataFrame[19];
-			motion_sensitivity[6] = dataFrame[20];
-			motion_sensitivity[7] = dataFrame[21];
-			motion_sensitivity[8] = dataFrame[22];
-			stationary_sensitivity[0] = dataFrame[23];
-			stationary_sensitivity[1] = dataFrame[24];
-			stationary_sensitivity[2] = dataFrame[25];
-			stationary_sensitivity[3] = dataFrame[26];
-			stationary_sensitivity[4] = dataFrame[27];
-			stationary_sensitivity[5] = dataFrame[28];
-			stationary_sensitivity[6] = dataFrame[29];
-			stationary_sensitivity[7] = dataFrame[30];
-			stationary_sensitivity[8] = dataFrame[31];
-			sensor_idle_time = dataFrame[32];
-			sensor_idle_time += (dataFrame[33] << 8);
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("\nMax gate distance: "));
-				debugSerial->print(max_gate);
-				debugSerial->print(F("\nMax motion detecting gate distance: "));
-				debugSerial->print(max_moving_gate);
-				debugSerial->print(F("\nMax stationary detecting gate distance: "));
-				debugSerial->print(max_stationary_gate);
-				debugSerial->print(F("\nSensitivity per gate"));
-				for (uint8_t i = 0; i < 9; i++)
-				{
-					debugSerial->print(F("\nGate "));
-					debugSerial->print(i);
-					debugSerial->print(F(" ("));
-					debugSerial->print(i * 0.75);
-					debugSerial->print('-');
-					debugSerial->print((i + 1) * 0.75);
-					debugSerial->print(F(" metres) Motion: "));
-					debugSerial->print(motion_sensitivity[i]);
-					debugSerial->print(F(" Stationary: "));
-					debugSerial->print(stationary_sensitivity[i]);
+		return false;
+	}
+	encode_max_values_(commands[commandCount++], moving, stationary, inactivityTimer);
+	return true;
+}
 
-				}
-				debugSerial->print(F("\nSensor idle timeout: "));
-				debugSerial->print(sensor_idle_time);
-				debugSerial->print('s');
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+bool LD2410ConfigurationBatch::setGateSensitivityThreshold(uint8_t gate, uint8_t moving, uint8_t stationary) {
+	if (commandCount == LD2410_MAX_BATCH_LENGTH)
+	{
+		return false;
 	}
-	else if (intraDataFrameLength == 4 && uartLatestAck == 0x64)
+	encode_gate_sensitivity_threshold_(commands[commandCount++], gate, moving, stationary);
+	return true;
+}
+
+bool LD2410ConfigurationBatch::requestCurrentConfiguration() {
+	if (commandCount == LD2410_MAX_BATCH_LENGTH)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for setting sensitivity values: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		return false;
 	}
-	else if (intraDataFrameLength == 12 && uartLatestAck == 0xA0)
+	encode_command_<LD2410ReadConfigurationFrame>(commands[commandCount++]);
+	return true;
+}
+
+void LD2410ConfigurationBatch::clear() {
+	commandCount = 0;
+}
+
+uint8_t LD2410ConfigurationBatch::size() {
+	return commandCount;
+}
+
+uint8_t LD2410ConfigurationBatch::command(uint8_t index) {
+	return index < commandCount ? commands[index].command() : 0;
+}
+
+LD2410CommandStatus LD2410ConfigurationBatch::status(uint8_t index) {
+	return index < commandCount ? commands[index].status : LD2410_COMMAND_UNKNOWN;
+}
+
+LD2410CommandHandle LD2410::requestStartEngineeringModeAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410StartEngineeringModeFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestEndEngineeringModeAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410EndEngineeringModeFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestCurrentConfigurationAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410ReadConfigurationFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestFirmwareVersionAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410FirmwareVersionFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestRestartAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410RestartFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestFactoryResetAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410FactoryResetFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestMacAddressAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410MacAddressFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::requestDistanceResolutionAsync(LD2410CommandCallback callback) {
+	return queue_command_<LD2410DistanceResolutionFrame>(callback);
+}
+
+LD2410CommandHandle LD2410::setMaxValuesAsync(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer, LD2410CommandCallback callback) {
+	queued_command_* queued = reserve_command_(callback);
+	if (queued == nullptr)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for firmware version: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			firmware_major_version = dataFrame[13];
-			firmware_minor_version = dataFrame[12];
-			firmware_bugfix_version = dataFrame[14];
-			firmware_bugfix_version += dataFrame[15] << 8;
-			firmware_bugfix_version += dataFrame[16] << 16;
-			firmware_bugfix_version += dataFrame[17] << 24;
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		return 0;
+	}
+	encode_max_values_(queued->single, moving, stationary, inactivityTimer);
+	return submit_command_(queued);
+}
+
+LD2410CommandHandle LD2410::setGateSensitivityThresholdAsync(uint8_t gate, uint8_t moving, uint8_t stationary, LD2410CommandCallback callback) {
+	queued_command_* queued = reserve_command_(callback);
+	if (queued == nullptr)
+	{
+		return 0;
 	}
-	else if (intraDataFrameLength == 4 && uartLatestAck == 0xA2)
+	encode_gate_sensitivity_threshold_(queued->single, gate, moving, stationary);
+	return submit_command_(queued);
+}
+
+LD2410CommandHandle LD2410::applyConfigurationAsync(LD2410ConfigurationBatch& batch, LD2410CommandCallback callback) {
+	if (batch.commandCount == 0)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for factory reset: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		return 0;
 	}
-	else if (intraDataFrameLength == 4 && uartLatestAck == 0xA3)
+	queued_command_* queued = reserve_command_(callback);
+	if (queued == nullptr)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nACK for restart: "));
-		}
-#endif
-		if (wasLastCommandSuccessful)
-		{
-			uartLastPacket = millis();
-#ifdef LD2410_DEBUG_COMMANDS
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("OK"));
-			}
-#endif
-			return true;
-		}
-		else
-		{
-			if (debugSerial != nullptr)
-			{
-				debugSerial->print(F("failed"));
-			}
-			return false;
-		}
+		return 0;
 	}
-	else
+	for (uint8_t i = 0; i < batch.commandCount; i++)
 	{
-#ifdef LD2410_DEBUG_COMMANDS
-		if (debugSerial != nullptr)
-		{
-			debugSerial->print(F("\nUnknown ACK"));
-		}
-#endif
+		batch.commands[i].status = LD2410_COMMAND_QUEUED;
 	}
-	return false;
+	queued->commands = batch.commands;
+	queued->commandCount = batch.commandCount;
+	return submit_command_(queued);
 }
 
-void LD2410::send_command_preamble_() {
-	//Command preamble
-	serial.write((byte)0xFD);
-	serial.write((byte)0xFC);
-	serial.write((byte)0xFB);
-	serial.write((byte)0xFA);
-}
-
-void LD2410::send_command_postamble_() {
-	//Command end
-	serial.write((byte)0x04);
-	serial.write((byte)0x03);
-	serial.write((byte)0x02);
-	serial.write((byte)0x01);
-}
-
-bool LD2410::enter_configuration_mode_() {
-	send_command_preamble_();
-	//Request firmware
-	serial.write((byte)0x04);	//Command is four bytes long
-	serial.write((byte)0x00);
-	serial.write((byte)0xFF);	//Request enter command mode
-	serial.write((byte)0x00);
-	serial.write((byte)0x01);
-	serial.write((byte)0x00);
-	send_command_postamble_();
-	uartLastCommand = millis();
-	while (millis() - uartLastCommand < uartTimeout)
+LD2410CommandStatus LD2410::commandStatus(LD2410CommandHandle handle) {
+	for (uint8_t i = 0; i < LD2410_COMMAND_QUEUE_LENGTH; i++)
 	{
-		if (read_frame_())
+		if (handle != 0 && commandQueue[i].handle == handle)
 		{
-			if (uartLatestAck == 0xFF && wasLastCommandSuccessful)
-			{
-				return true;
-			}
+			return commandQueue[i].status;
 		}
 	}
-	return false;
+	return LD2410_COMMAND_UNKNOWN;
+}
+
+bool LD2410::commandPending() {
+	return commandQueueCount > 0 || commandState != COMMAND_IDLE;
+}
+
+bool LD2410::requestStartEngineeringMode() {
+	return wait_for_command_(requestStartEngineeringModeAsync());
+}
+
+bool LD2410::requestEndEngineeringMode() {
+	return wait_for_command_(requestEndEngineeringModeAsync());
+}
+
+bool LD2410::requestCurrentConfiguration() {
+	return wait_for_command_(requestCurrentConfigurationAsync());
 }
 
-bool LD2410::leave_configuration_mode_() {
-	send_command_preamble_();
-	//Request firmware
-	serial.write((byte)0x02);	//Command is four bytes long
-	serial.write((byte)0x00);
-	serial.write((byte)0xFE);	//Request leave command mode
-	serial.write((byte)0x00);
-	send_command_postamble_();
+bool LD2410::requestFirmwareVersion() {
+	return wait_for_command_(requestFirmwareVersionAsync());
+}
+
+bool LD2410::requestRestart() {
+	return wait_for_command_(requestRestartAsync());
+}
+
+bool LD2410::requestFactoryReset() {
+	return wait_for_command_(requestFactoryResetAsync());
+}
+
+bool LD2410::requestMacAddress() {
+	return wait_for_command_(requestMacAddressAsync());
+}
+
+bool LD2410::requestDistanceResolution() {
+	return wait_for_command_(requestDistanceResolutionAsync());
+}
+
+bool LD2410::setMaxValues(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer) {
+	return wait_for_command_(setMaxValuesAsync(moving, stationary, inactivityTimer));
+}
+
+bool LD2410::setGateSensitivityThreshold(uint8_t gate, uint8_t moving, uint8_t stationary) {
+	return wait_for_command_(setGateSensitivityThresholdAsync(gate, moving, stationary));
+}
+
+bool LD2410::applyConfiguration(LD2410ConfigurationBatch& batch) {
+	return wait_for_command_(applyConfigurationAsync(batch));
+}
+
+void LD2410::send_command_(const LD2410Command& command) {
+	LD2410_LOG(LD2410_LOG_COMMANDS, LD2410_LOG_COMMAND_SENT, command.command(), command.frameLength);
+	serial.write(command.frame(), command.frameLength);	//One write so the UART sends the frame as a single burst
+	uartLastCommand = millis();
+}
+
+void LD2410::send_enter_configuration_mode_() {
+	serial.write(LD2410EnterConfigurationFrame::bytes, sizeof(LD2410EnterConfigurationFrame::bytes));
 	uartLastCommand = millis();
-	while (millis() - uartLastCommand < uartTimeout)
+	commandState = COMMAND_ENTERING_CONFIGURATION;
+}
+
+void LD2410::send_leave_configuration_mode_() {
+	serial.write(LD2410LeaveConfigurationFrame::bytes, sizeof(LD2410LeaveConfigurationFrame::bytes));
+	uartLastCommand = millis();
+	commandState = COMMAND_LEAVING_CONFIGURATION;
+}
+
+void LD2410::start_queued_command_() {
+	queued_command_& current = commandQueue[commandQueueHead];
+	current.status = LD2410_COMMAND_IN_PROGRESS;
+	commandsSent = 0;
+	commandsAcked = 0;
+	commandState = COMMAND_AWAITING_ACK;
+	send_pipelined_commands_();
+}
+
+void LD2410::send_pipelined_commands_() {
+	queued_command_& current = commandQueue[commandQueueHead];
+	uint16_t bytesInFlight = 0;
+	for (uint8_t i = commandsAcked; i < commandsSent; i++)
 	{
-		if (read_frame_())
+		bytesInFlight += current.commands[i].frameLength;
+	}
+	while (commandsSent < current.commandCount && commandsSent - commandsAcked < LD2410_BATCH_PIPELINE_DEPTH)
+	{
+		LD2410Command& command = current.commands[commandsSent];
+		if (commandsSent > commandsAcked)	//The first command always goes, the rest wait until the radar has room
 		{
-			if (uartLatestAck == 0xFE && wasLastCommandSuccessful)
+			if (bytesInFlight + command.frameLength > commandBufferSize)
+			{
+				break;
+			}
+			bool sameCommandInFlight = false;	//ACKs only carry the opcode, so two of a kind could not be told apart
+			for (uint8_t i = commandsAcked; i < commandsSent; i++)
+			{
+				sameCommandInFlight = sameCommandInFlight || current.commands[i].command() == command.command();
+			}
+			if (sameCommandInFlight)
 			{
-				return true;
+				break;
 			}
 		}
+		commandsSent++;
+		bytesInFlight += command.frameLength;
+		command.status = LD2410_COMMAND_IN_PROGRESS;
+		send_command_(command);
 	}
-	return false;
 }
 
-bool LD2410::requestStartEngineeringMode() {
-	send_command_preamble_();
-	//Request firmware
-	serial.write((byte)0x02);	//Command is four bytes long
-	serial.write((byte)0x00);
-	serial.write((byte)0x62);	//Request enter command mode
-	serial.write((byte)0x00);
-	send_command_postamble_();
-	uartLastCommand = millis();
-	while (millis() - uartLastCommand < uartTimeout)
+LD2410::queued_command_* LD2410::reserve_command_(LD2410CommandCallback callback) {
+	if (commandQueueCount == LD2410_COMMAND_QUEUE_LENGTH)
+	{
+		return nullptr;
+	}
+	queued_command_* queued = &commandQueue[(commandQueueHead + commandQueueCount) % LD2410_COMMAND_QUEUE_LENGTH];
+	queued->handle = 0;
+	queued->status = LD2410_COMMAND_UNKNOWN;
+	queued->commands = &queued->single;
+	queued->commandCount = 1;
+	queued->callback = callback;
+	return queued;
+}
+
+LD2410CommandHandle LD2410::submit_command_(queued_command_* queued) {
+	if (++lastCommandHandle == 0)	//Zero is reserved for a rejected command
 	{
-		if (read_frame_())
-		{
-			if (uartLatestAck == 0x62 && wasLastCommandSuccessful)
-			{
-				return true;
-			}
-		}
+		lastCommandHandle = 1;
 	}
-	return false;
+	queued->handle = lastCommandHandle;
+	queued->status = LD2410_COMMAND_QUEUED;
+	commandQueueCount++;
+	service_commands_();	//Start straight away if the radar is idle
+	return queued->handle;
 }
 
-bool LD2410::requestEndEngineeringMode() {
-	send_command_preamble_();
-	//Request firmware
-	serial.write((byte)0x02);	//Command is four bytes long
-	serial.write((byte)0x00);
-	serial.write((byte)0x63);	//Request leave command mode
-	serial.write((byte)0x00);
-	send_command_postamble_();
-	uartLastCommand = millis();
-	while (millis() - uartLastCommand < uartTimeout)
+template <typename Frame>
+LD2410CommandHandle LD2410::queue_command_(LD2410CommandCallback callback) {
+	queued_command_* queued = reserve_command_(callback);
+	if (queued == nullptr)
 	{
-		if (read_frame_())
-		{
-			if (uartLatestAck == 0x63 && wasLastCommandSuccessful)
-			{
-				return true;
-			}
-		}
+		return 0;
 	}
-	return false;
+	encode_command_<Frame>(queued->single);
+	return submit_command_(queued);
 }
 
-bool LD2410::requestCurrentConfiguration() {
-	if (enter_configuration_mode_())
+void LD2410::complete_command_(LD2410CommandStatus status) {
+	queued_command_& current = commandQueue[commandQueueHead];
+	for (uint8_t i = commandsAcked; i < current.commandCount; i++)	//Anything not yet acknowledged shares the fate of the whole command
 	{
-		delay(50);
-		send_command_preamble_();
-		//Request firmware
-		serial.write((byte)0x02);	//Command is two bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0x61);	//Request current configuration
-		serial.write((byte)0x00);
-		send_command_postamble_();
-		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
+		current.commands[i].status = status;
+	}
+	if (status == LD2410_COMMAND_SUCCEEDED)
+	{
+		for (uint8_t i = 0; i < current.commandCount; i++)
 		{
-			if (read_frame_())
+			if (current.commands[i].status != LD2410_COMMAND_SUCCEEDED)
 			{
-				if (uartLatestAck == 0x61 && wasLastCommandSuccessful)
-				{
-					delay(50);
-					leave_configuration_mode_();
-					return true;
-				}
+				status = current.commands[i].status;
+				break;
 			}
 		}
 	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
+	LD2410CommandCallback callback = current.callback;
+	current.callback = nullptr;
+	current.status = status;
+	if (status != LD2410_COMMAND_SUCCEEDED)
+	{
+		LD2410_LOG(LD2410_LOG_ERROR, LD2410_LOG_COMMAND_FAILED, current.commands[0].command(), status);
+	}
+	commandQueueHead = (commandQueueHead + 1) % LD2410_COMMAND_QUEUE_LENGTH;
+	commandQueueCount--;
+	if (callback)
+	{
+		callback(status);
+	}
 }
 
-bool LD2410::requestFirmwareVersion() {
-	if (enter_configuration_mode_())
+void LD2410::handle_command_ack_(uint8_t ack, bool success) {
+	switch (commandState)
 	{
-		delay(50);
-		send_command_preamble_();
-		//Request firmware
-		serial.write((byte)0x02);	//Command is two bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0xA0);	//Request firmware version
-		serial.write((byte)0x00);
-		send_command_postamble_();
-		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
+	case COMMAND_ENTERING_CONFIGURATION:
+		if (ack == 0xFF)
 		{
-			read_frame_();
-			if (uartLatestAck == 0xA0 && wasLastCommandSuccessful)
+			if (success)
 			{
-				delay(50);
-				leave_configuration_mode_();
-				return true;
+				start_queued_command_();
+			}
+			else
+			{
+				commandState = COMMAND_IDLE;
+				complete_command_(LD2410_COMMAND_FAILED);
 			}
 		}
-	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
-}
-
-bool LD2410::requestRestart() {
-	if (enter_configuration_mode_())
+		break;
+	case COMMAND_AWAITING_ACK:
 	{
-		delay(50);
-		send_command_preamble_();
-		//Request firmware
-		serial.write((byte)0x02);	//Command is two bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0xA3);	//Request restart
-		serial.write((byte)0x00);
-		send_command_postamble_();
+		queued_command_& current = commandQueue[commandQueueHead];
+		uint8_t acked = commandsAcked;
+		while (acked < commandsSent && current.commands[acked].command() != ack)	//ACKs arrive in order, so any skipped command was lost
+		{
+			acked++;
+		}
+		if (acked == commandsSent)
+		{
+			break;
+		}
+		while (commandsAcked < acked)
+		{
+			current.commands[commandsAcked++].status = LD2410_COMMAND_TIMED_OUT;
+		}
+		current.commands[commandsAcked++].status = success ? LD2410_COMMAND_SUCCEEDED : LD2410_COMMAND_FAILED;
 		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
+		if (commandsAcked < current.commandCount)
 		{
-			if (read_frame_())
-			{
-				if (uartLatestAck == 0xA3 && wasLastCommandSuccessful)
-				{
-					delay(50);
-					leave_configuration_mode_();
-					return true;
-				}
-			}
+			send_pipelined_commands_();
+			break;
+		}
+		complete_command_(LD2410_COMMAND_SUCCEEDED);
+		if (ack == 0xA3 && success)	//The radar restarts, so configuration mode is already over
+		{
+			commandState = COMMAND_IDLE;
 		}
+		else if (commandQueueCount > 0)	//Stay in configuration mode for the next command
+		{
+			start_queued_command_();
+		}
+		else
+		{
+			send_leave_configuration_mode_();
+		}
+		break;
+	}
+	case COMMAND_LEAVING_CONFIGURATION:
+		if (ack == 0xFE)
+		{
+			commandState = COMMAND_IDLE;
+		}
+		break;
+	default:
+		break;
 	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
 }
 
-bool LD2410::requestFactoryReset() {
-	if (enter_configuration_mode_())
+void LD2410::service_commands_() {
+	if (commandState == COMMAND_IDLE)
 	{
-		delay(50);
-		send_command_preamble_();
-		//Request firmware
-		serial.write((byte)0x02);	//Command is two bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0xA2);	//Request factory reset
-		serial.write((byte)0x00);
-		send_command_postamble_();
-		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
+		if (commandQueueCount > 0)
 		{
-			if (read_frame_())
-			{
-				if (uartLatestAck == 0xA2 && wasLastCommandSuccessful)
-				{
-					delay(50);
-					leave_configuration_mode_();
-					return true;
-				}
-			}
+			commandQueue[commandQueueHead].status = LD2410_COMMAND_IN_PROGRESS;
+			commandsSent = 0;
+			commandsAcked = 0;
+			send_enter_configuration_mode_();
 		}
 	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
-}
-
-bool LD2410::setMaxValues(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer) {
-	if (enter_configuration_mode_())
+	else if (millis() - uartLastCommand >= uartTimeout)
 	{
-		delay(50);
-		send_command_preamble_();
-		serial.write((byte)0x14);	//Command is 20 bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0x60);	//Request set max values
-		serial.write((byte)0x00);
-		serial.write((byte)0x00);	//Moving gate command
-		serial.write((byte)0x00);
-		serial.write(char(moving & 0x00FF));	//Moving gate value
-		serial.write(char((moving & 0xFF00) >> 8));
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		serial.write((byte)0x01);	//Stationary gate command
-		serial.write((byte)0x00);
-		serial.write(char(stationary & 0x00FF));	//Stationary gate value
-		serial.write(char((stationary & 0xFF00) >> 8));
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		serial.write((byte)0x02);	//Inactivity timer command
-		serial.write((byte)0x00);
-		serial.write(char(inactivityTimer & 0x00FF));	//Inactivity timer
-		serial.write(char((inactivityTimer & 0xFF00) >> 8));
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		send_command_postamble_();
-		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
+		if (commandState == COMMAND_LEAVING_CONFIGURATION)
 		{
-			if (read_frame_())
-			{
-				if (uartLatestAck == 0x60 && wasLastCommandSuccessful)
-				{
-					delay(50);
-					leave_configuration_mode_();
-					return true;
-				}
-			}
+			commandState = COMMAND_IDLE;
+			service_commands_();
+		}
+		else
+		{
+			send_leave_configuration_mode_();	//The radar may have entered configuration mode without the ACK arriving
+			complete_command_(LD2410_COMMAND_TIMED_OUT);
 		}
 	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
 }
 
-bool LD2410::setGateSensitivityThreshold(uint8_t gate, uint8_t moving, uint8_t stationary) {
-	if (enter_configuration_mode_())
+bool LD2410::wait_for_command_(LD2410CommandHandle handle) {
+	LD2410CommandStatus status = commandStatus(handle);
+	while (status == LD2410_COMMAND_QUEUED || status == LD2410_COMMAND_IN_PROGRESS)
 	{
-		delay(50);
-		send_command_preamble_();
-		serial.write((byte)0x14);	//Command is 20 bytes long
-		serial.write((byte)0x00);
-		serial.write((byte)0x64);	//Request set sensitivity values
-		serial.write((byte)0x00);
-		serial.write((byte)0x00);	//Gate command
-		serial.write((byte)0x00);
-		serial.write(char(gate));	//Gate value
-		serial.write((byte)0x00);
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		serial.write((byte)0x01);	//Motion sensitivity command
-		serial.write((byte)0x00);
-		serial.write(char(moving));	//Motion sensitivity value
-		serial.write((byte)0x00);
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		serial.write((byte)0x02);	//Stationary sensitivity command
-		serial.write((byte)0x00);
-		serial.write(char(stationary));	//Stationary sensitivity value
-		serial.write((byte)0x00);
-		serial.write((byte)0x00);	//Spacer
-		serial.write((byte)0x00);
-		send_command_postamble_();
-		uartLastCommand = millis();
-		while (millis() - uartLastCommand < uartTimeout)
-		{
-			if (read_frame_())
-			{
-				if (uartLatestAck == 0x64 && wasLastCommandSuccessful)
-				{
-					delay(50);
-					leave_configuration_mode_();
-					return true;
-				}
-			}
-		}
+		read();
+		status = commandStatus(handle);
 	}
-	delay(50);
-	leave_configuration_mode_();
-	return false;
-}
\ No newline at end of file
+	return status == LD2410_COMMAND_SUCCEEDED;
+}
@@ -13,21 +13,111 @@
 #ifndef LD2410_H
 #define LD2410_H
 #include <Arduino.h>
+#include <functional>
+#include "../../Util/RingBuffer.h"
 
-#define LD2410_MAX_FRAME_LENGTH 40
- //#define LD2410_DEBUG_DATA
-#define LD2410_DEBUG_COMMANDS
-//#define LD2410_DEBUG_PARSE
+#define LD2410_MAX_FRAME_LENGTH 64								//Largest frame is the 45 byte engineering mode report
+#define LD2410_MAX_GATES 9
+#define LD2410_COMMAND_QUEUE_LENGTH 8							//Commands that can be waiting for the radar at once
+#define LD2410_MAX_COMMAND_FRAME_LENGTH 30						//Longest command frame, used by 0x60 and 0x64
+#define LD2410_MAX_BATCH_LENGTH 11								//Max values, every gate and a readback
+#define LD2410_BATCH_PIPELINE_DEPTH 4							//Batch commands sent ahead of their ACKs, as far as the radar's command buffer allows
+#define LD2410_DEFAULT_COMMAND_BUFFER LD2410_MAX_COMMAND_FRAME_LENGTH	//Command bytes assumed to fit until the radar reports its buffer size
+#define LD2410_ACK_INDEX_LENGTH 32								//Slots in the ACK dispatch index, a power of two
+
+/*
+ * Logging is selected at compile time. Below LD2410_LOG_LEVEL nothing is compiled in; at or above it the parser
+ * pushes small binary records into a RAM ring, which drainLog() formats onto the debug stream when the caller has time.
+ */
+#define LD2410_LOG_NONE 0
+#define LD2410_LOG_ERROR 1												//Framing errors, unknown frames and failed commands
+#define LD2410_LOG_COMMANDS 2											//Commands sent and ACKs received
+#define LD2410_LOG_DATA 3												//Every data frame
+#ifndef LD2410_LOG_LEVEL
+#define LD2410_LOG_LEVEL LD2410_LOG_ERROR
+#endif
+#define LD2410_LOG_BUFFER_LENGTH 32										//Records held until drainLog(), a power of two
+
+struct LD2410EngineeringData {									//Per gate energies from engineering mode, updated in place by each frame
+	uint8_t movingGates = 0;										//Number of valid entries in movingEnergy
+	uint8_t stationaryGates = 0;									//Number of valid entries in stationaryEnergy
+	uint8_t movingEnergy[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
+	uint8_t stationaryEnergy[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
+	uint32_t lastUpdate = 0;										//millis() of the last engineering frame
+};
+
+enum LD2410CommandStatus : uint8_t {
+	LD2410_COMMAND_QUEUED,
+	LD2410_COMMAND_IN_PROGRESS,
+	LD2410_COMMAND_SUCCEEDED,
+	LD2410_COMMAND_FAILED,											//The radar rejected the command
+	LD2410_COMMAND_TIMED_OUT,
+	LD2410_COMMAND_UNKNOWN											//Handle was rejected or its slot has been reused
+};
+
+enum LD2410LogEvent : uint8_t {
+	LD2410_LOG_FRAME_OVERRUN,										//arg8 ACK frame, arg16 declared length
+	LD2410_LOG_FRAME_LENGTH_MISMATCH,								//arg8 received length, arg16 declared length
+	LD2410_LOG_UNKNOWN_FRAME,										//arg8 data type, arg16 intra frame length
+	LD2410_LOG_UNKNOWN_ACK,											//arg8 ACK opcode, arg16 intra frame length
+	LD2410_LOG_COMMAND_FAILED,										//arg8 command, arg16 LD2410CommandStatus
+	LD2410_LOG_COMMAND_SENT,										//arg8 command, arg16 frame length
+	LD2410_LOG_ACK,													//arg8 ACK opcode, arg16 success
+	LD2410_LOG_CONFIGURATION,										//arg8 max gate, arg16 idle time
+	LD2410_LOG_DATA_FRAME,											//arg8 target type, arg16 target distance
+	LD2410_LOG_ENGINEERING_FRAME									//arg8 target type, arg16 gates reported
+};
+
+struct LD2410LogRecord {
+	uint32_t timestamp;												//micros() when the record was made
+	LD2410LogEvent event;
+	uint8_t arg8;
+	uint16_t arg16;
+};
+
+typedef uint16_t LD2410CommandHandle;								//Zero when the command could not be queued
+typedef std::function<void(LD2410CommandStatus status)> LD2410CommandCallback;
+
+struct LD2410Command {											//A complete command frame, ready to write to the radar
+	const uint8_t* constantFrame = nullptr;							//Frame in flash for commands without parameters
+	uint8_t encodedFrame[LD2410_MAX_COMMAND_FRAME_LENGTH];			//Frame built from its template for commands with parameters
+	uint8_t frameLength = 0;
+	LD2410CommandStatus status = LD2410_COMMAND_UNKNOWN;
+	const uint8_t* frame() const;
+	uint8_t command() const;
+};
+
+/*
+ * A set of configuration writes sent in one configuration mode session, with each command's ACK status kept.
+ * Add requestCurrentConfiguration() last to read the result back before leaving configuration mode.
+ * The batch must stay in scope until its command completes.
+ */
+class LD2410ConfigurationBatch {
+
+public:
+	bool setMaxValues(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer);	//False when the batch is full
+	bool setGateSensitivityThreshold(uint8_t gate, uint8_t moving, uint8_t stationary);
+	bool requestCurrentConfiguration();
+	void clear();
+	uint8_t size();
+	uint8_t command(uint8_t index);
+	LD2410CommandStatus status(uint8_t index);						//ACK status of each command in the order they were added
+private:
+	friend class LD2410;
+	LD2410Command commands[LD2410_MAX_BATCH_LENGTH];
+	uint8_t commandCount = 0;
+};
 
 class LD2410 {
 
 public:
-	LD2410(HardwareSerial& serialPort);														//Constructor function
+	LD2410(Stream& serialPort);													//Constructor function, the UART or anything else that speaks the protocol
 	~LD2410();														//Destructor function
 	bool begin(bool waitForRadar = true);					//Start the ld2410
 	void debug(Stream& terminalStream);											//Start debugging on a stream
+	uint16_t drainLog(uint16_t maxRecords = LD2410_LOG_BUFFER_LENGTH);			//Print queued log records to the debug stream, call when there is time to spare
 	bool isConnected();
-	bool read();
+	uint16_t read();											//Drain the UART, returns the number of frames decoded
 	bool presenceDetected();
 	bool stationaryTargetDetected();
 	uint16_t getStationaryTargetDistance();
@@ -35,6 +125,28 @@ public:
 	bool movingTargetDetected();
 	uint16_t getMovingTargetDistance();
 	uint8_t getMovingTargetEnergy();
+	bool engineeringDataAvailable();								//The latest data frame carried per gate energies
+	const LD2410EngineeringData& getEngineeringData();
+	uint8_t getMovingGateEnergy(uint8_t gate);
+	uint8_t getStationaryGateEnergy(uint8_t gate);
+	/*
+	 * Commands run asynchronously, read() steps each one through entering configuration mode, sending it and leaving configuration mode again.
+	 * The callback runs from read() when the command completes; do not call the blocking variants from it.
+	 */
+	LD2410CommandHandle requestFirmwareVersionAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestCurrentConfigurationAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestRestartAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestFactoryResetAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestStartEngineeringModeAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestEndEngineeringModeAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestMacAddressAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle requestDistanceResolutionAsync(LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle setMaxValuesAsync(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer, LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle setGateSensitivityThresholdAsync(uint8_t gate, uint8_t moving, uint8_t stationary, LD2410CommandCallback callback = nullptr);
+	LD2410CommandHandle applyConfigurationAsync(LD2410ConfigurationBatch& batch, LD2410CommandCallback callback = nullptr);
+	LD2410CommandStatus commandStatus(LD2410CommandHandle handle);	//Poll a queued command
+	bool commandPending();											//Whether any command is queued or in flight
+	//Blocking variants, these call read() until the command completes
 	bool requestFirmwareVersion();									//Request the firmware version
 	uint8_t firmware_major_version = 0;								//Reported major version
 	uint8_t firmware_minor_version = 0;								//Reported minor version
@@ -44,17 +156,22 @@ public:
 	uint8_t max_moving_gate = 0;
 	uint8_t max_stationary_gate = 0;
 	uint16_t sensor_idle_time = 0;
-	uint8_t motion_sensitivity[9] = { 0,0,0,0,0,0,0,0,0 };
-	uint8_t stationary_sensitivity[9] = { 0,0,0,0,0,0,0,0,0 };
+	uint8_t motion_sensitivity[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
+	uint8_t stationary_sensitivity[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
 	bool requestRestart();
 	bool requestFactoryReset();
 	bool requestStartEngineeringMode();
 	bool requestEndEngineeringMode();
+	bool requestMacAddress();
+	uint8_t mac_address[6] = { 0,0,0,0,0,0 };
+	bool requestDistanceResolution();
+	uint16_t distance_resolution = 0;								//0 for 0.75m gates, 1 for 0.2m gates
 	bool setMaxValues(uint16_t moving, uint16_t stationary, uint16_t inactivityTimer);	//Realistically gate values are 0-8 but sent as uint16_t
 	bool setGateSensitivityThreshold(uint8_t gate, uint8_t moving, uint8_t stationary);
+	bool applyConfiguration(LD2410ConfigurationBatch& batch);
 protected:
 private:
-	HardwareSerial& serial;
+	Stream& serial;
 	Stream* debugSerial = nullptr;									//The stream used for the debugging
 	uint32_t uartTimeout = 100;								//How long to give up on receiving some useful data from the LD2410
 	uint32_t uartLastPacket = 0;							//Time of the last packet from the radar
@@ -62,7 +179,8 @@ private:
 	uint8_t uartLatestAck = 0;
 	bool wasLastCommandSuccessful = false;
 	uint8_t dataFrame[LD2410_MAX_FRAME_LENGTH];				//Store the incoming data from the radar, to check it's in a valid format
-	uint8_t dataFramePosition = 0;							//Where in the frame we are currently writing
+	uint8_t dataFramePosition = 0;							//Where in the frame we are currently writing, kept across calls so frames can span reads
+	uint16_t dataFrameLength = 0;							//Expected length of the current frame, known once the length bytes arrive
 	bool isAckFrame = false;										//Whether the incoming frame is LIKELY an ACK frame
 	bool isWaitingForAck = false;									//Whether a command has just been sent
 	uint8_t targetType = 0;
@@ -71,14 +189,70 @@ private:
 	uint16_t stationaryTargetDistance = 0;
 	uint8_t stationaryTargetEnergy = 0;
 	uint8_t detectionDistance = 0;
+	LD2410EngineeringData engineeringData;
+	struct ack_decoder_ {
+		uint8_t ack;												//ACK opcode, the low byte of the command word
+		uint8_t length;												//Expected intra frame length
+		void (LD2410::*decode)();
+	};
+	struct ack_index_ {
+		uint8_t entry[LD2410_ACK_INDEX_LENGTH];						//ackDecoders position plus one, zero for an empty slot
+		bool collision;
+	};
+	static const ack_decoder_ ackDecoders[];
+	static constexpr uint8_t ack_slot_(uint8_t ack);				//Hash of the ACK opcode into ackIndex
+	static constexpr ack_index_ build_ack_index_();
+	static const ack_index_ ackIndex;
+	enum CommandState : uint8_t {
+		COMMAND_IDLE,
+		COMMAND_ENTERING_CONFIGURATION,
+		COMMAND_AWAITING_ACK,
+		COMMAND_LEAVING_CONFIGURATION
+	};
+	struct queued_command_ {
+		LD2410CommandHandle handle = 0;
+		LD2410CommandStatus status = LD2410_COMMAND_UNKNOWN;
+		LD2410Command single;										//Storage for a command queued on its own
+		LD2410Command* commands = nullptr;							//Either single or the commands of a batch
+		uint8_t commandCount = 0;
+		LD2410CommandCallback callback;
+	};
+	queued_command_ commandQueue[LD2410_COMMAND_QUEUE_LENGTH];		//Ring of commands, completed entries keep their status until reused
+	uint8_t commandQueueHead = 0;									//Command currently being sent to the radar
+	uint8_t commandQueueCount = 0;
+	LD2410CommandHandle lastCommandHandle = 0;
+	CommandState commandState = COMMAND_IDLE;
+	uint8_t commandsSent = 0;										//Commands of the head entry written to the radar
+	uint8_t commandsAcked = 0;										//Commands of the head entry acknowledged, in order
+	uint16_t commandBufferSize = LD2410_DEFAULT_COMMAND_BUFFER;		//Command bytes the radar holds awaiting ACK, from the enter configuration ACK
+	bool isEngineeringFrame = false;								//Whether the latest data frame was an engineering mode frame
 
-	bool read_frame_();												//Try to read a frame from the UART
+	uint16_t read_frame_();											//Drain the bytes the UART has buffered, returns the number of frames decoded
+	bool append_byte_(uint8_t byte_read_);							//Feed one byte to the frame state machine, true when a frame is complete
 	bool parse_data_frame_();										//Is the current data frame valid?
 	bool parse_command_frame_();									//Is the current command frame valid?
-	void print_frame_();											//Print the frame for debugging
-	void send_command_preamble_();									//Commands have the same preamble
-	void send_command_postamble_();									//Commands have the same postamble
-	bool enter_configuration_mode_();								//Necessary before sending any command
-	bool leave_configuration_mode_();								//Will not read values without leaving command mode
+	void decode_enter_configuration_ack_();
+	void decode_configuration_ack_();
+	void decode_firmware_version_ack_();
+	void decode_mac_address_ack_();
+	void decode_distance_resolution_ack_();
+#if LD2410_LOG_LEVEL > LD2410_LOG_NONE
+	RingBuffer<LD2410LogRecord, LD2410_LOG_BUFFER_LENGTH> logBuffer;
+	void log_(LD2410LogEvent event, uint8_t arg8, uint16_t arg16);
+	void print_log_record_(const LD2410LogRecord& record);
+#endif
+	void send_command_(const LD2410Command& command);
+	void send_enter_configuration_mode_();							//Necessary before sending any command
+	void send_leave_configuration_mode_();							//Will not read values without leaving command mode
+	void start_queued_command_();									//Start sending the entry at the head of the queue
+	void send_pipelined_commands_();								//Keep up to LD2410_BATCH_PIPELINE_DEPTH commands awaiting ACK, within commandBufferSize
+	queued_command_* reserve_command_(LD2410CommandCallback callback);
+	LD2410CommandHandle submit_command_(queued_command_* queued);
+	template <typename Frame>
+	LD2410CommandHandle queue_command_(LD2410CommandCallback callback);	//Queue a command without parameters
+	void complete_command_(LD2410CommandStatus status);				//Retire the command at the head of the queue
+	void handle_command_ack_(uint8_t ack, bool success);			//Advance the command state machine on an ACK
+	void service_commands_();										//Start queued commands and expire stalled ones
+	bool wait_for_command_(LD2410CommandHandle handle);
 };
 #endif // LD2410_H
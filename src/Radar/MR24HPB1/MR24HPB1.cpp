@@ -6,10 +6,13 @@
 namespace MR24HPB1
 {
 
-  MR24HPB1::MR24HPB1(HardwareSerial &serialPort, uint8_t presencePin, uint8_t motionPin) : serial(serialPort)
+  MR24HPB1::MR24HPB1(HardwareSerial &serialPort, uint8_t presencePin, uint8_t motionPin) : MR24HPB1(static_cast<Stream &>(serialPort), presencePin, motionPin)
+  {
+    serialPort.begin(9600);
+  }
+
+  MR24HPB1::MR24HPB1(Stream &stream, uint8_t presencePin, uint8_t motionPin) : serial(stream)
   {
-    serial = serialPort;
-    serial.begin(9600);
     presence_pin = presencePin;
     motion_pin = motionPin;
     pinMode(presence_pin, INPUT);
@@ -51,30 +54,18 @@ namespace MR24HPB1
   }
   uint8_t MR24HPB1::getThreshold()
   {
-    uint8_t data[1];
-    sendMsg(READ, SYSTEM_PARAM, THRESHOLD_GEAR, data, 0);
-    yield(100);
     return threshold;
   }
   uint8_t MR24HPB1::getSceneSetting()
   {
-    uint8_t data[1];
-    sendMsg(READ, SYSTEM_PARAM, SCENE_SETTING, data, 0);
-    yield(100);
     return scene_setting;
   }
   uint8_t MR24HPB1::getMotorSigns()
   {
-    uint8_t data[1];
-    sendMsg(READ, RADAR_INFO, MOTOR_SIGNS, data, 0);
-    yield(100);
     return motor_signs;
   }
   uint8_t MR24HPB1::getEnvironmentalState()
   {
-    uint8_t data[1];
-    sendMsg(READ, RADAR_INFO, ENVIRONMENTAL_STATUS, data, 0);
-    yield(100);
     return environmental_state;
   }
   boolean MR24HPB1::getPresence()
@@ -91,122 +82,227 @@ namespace MR24HPB1
     updated_member = 0xFF;
     return member;
   }
+  uint32_t MR24HPB1::getAge(cached_field_t field)
+  {
+    if (field >= CACHED_FIELDS || (cached_fields & (1 << field)) == 0)
+      return MR24HPB1_NEVER;
+    return millis() - cached_at[field];
+  }
+  void MR24HPB1::requestRefresh(cached_field_t field)
+  {
+    // address codes the sensor answers each field's read on, in cached_field_t order
+    static const uint8_t address[CACHED_FIELDS][2] = {
+        {SYSTEM_PARAM, THRESHOLD_GEAR},
+        {SYSTEM_PARAM, SCENE_SETTING},
+        {RADAR_INFO, MOTOR_SIGNS},
+        {RADAR_INFO, ENVIRONMENTAL_STATUS},
+        {RADAR_INFO, APPROACHING_AWAY_STATE}};
+    if (field >= CACHED_FIELDS)
+      return;
+    sendMsg(READ, (addr_cmd1_t)address[field][0], (addr_cmd2_t)address[field][1], NULL, 0);
+  }
+  void MR24HPB1::requestRefresh()
+  {
+    for (uint8_t field = 0; field < CACHED_FIELDS; field++)
+      requestRefresh((cached_field_t)field);
+  }
 
   int MR24HPB1::setThreshold(uint8_t gear)
   {
-    if (gear <= 0 || gear > 10)
+    if (requestThreshold(gear) < 0)
       return -1;
-    uint8_t data[1] = {gear};
-    long start = millis();
-    long timeout = 10;
-    while (threshold != gear)
-    {
-      if (millis() - start > timeout)
-        return -2; // timeout
-      sendMsg(WRITE, SYSTEM_PARAM, THRESHOLD_GEAR, data, 1);
-      yield(50);
-    }
-    return 0;
+    return waitForWrite(CACHED_THRESHOLD);
   }
   int MR24HPB1::setSceneSetting(scene_setting_t scene)
   {
-    uint8_t data[1] = {(uint8_t)scene};
-    long start = millis();
-    long timeout = 10;
-    while (scene_setting != (uint8_t)scene)
+    if (requestSceneSetting(scene) < 0)
+      return -1;
+    return waitForWrite(CACHED_SCENE_SETTING);
+  }
+  int MR24HPB1::requestThreshold(uint8_t gear)
+  {
+    if (!validThreshold(gear))
+      return -1;
+    return requestWrite(CACHED_THRESHOLD, gear);
+  }
+  int MR24HPB1::requestSceneSetting(scene_setting_t scene)
+  {
+    if (!validScene(scene))
+      return -1;
+    return requestWrite(CACHED_SCENE_SETTING, scene);
+  }
+  boolean MR24HPB1::validThreshold(uint8_t gear)
+  {
+    return gear > 0 && gear <= 10;
+  }
+  boolean MR24HPB1::validScene(scene_setting_t scene)
+  {
+    return scene >= DEFAULT_SETTING && scene <= HOTEL;
+  }
+  write_state_t MR24HPB1::getWriteState(cached_field_t field)
+  {
+    return field < MR24HPB1_WRITABLE_FIELDS ? write_state[field] : WRITE_IDLE;
+  }
+  void MR24HPB1::setWriteTimeouts(uint32_t deadline, uint16_t first_retry)
+  {
+    write_deadline = deadline;
+    write_retry = first_retry > 0 ? first_retry : 1;
+  }
+  void MR24HPB1::Reboot()
+  {
+    sendMsg(WRITE, OTHER, REBOOT, NULL, 0);
+  }
+  boolean MR24HPB1::attachPinInterrupts()
+  {
+    if (pin_interrupts)
+      return true;
+    if (!attachInterrupt(digitalPinToInterrupt(presence_pin), [this]() { queuePinEdge(presence_pin); }, CHANGE))
+      return false;
+    if (!attachInterrupt(digitalPinToInterrupt(motion_pin), [this]() { queuePinEdge(motion_pin); }, CHANGE))
     {
-      if (millis() - start > timeout)
-        return -2; // timeout
-      sendMsg(WRITE, SYSTEM_PARAM, (addr_cmd2_t)0x10, data, 1);
-      yield(50);
+      detachInterrupt(digitalPinToInterrupt(presence_pin));
+      return false;
     }
-    return 0;
+    readPins(); // edges from here on are queued, the ones that repeat this level are skipped
+    pin_interrupts = true;
+    return true;
   }
-  void MR24HPB1::Reboot()
+  void MR24HPB1::detachPinInterrupts()
   {
-    uint8_t data[1];
-    sendMsg(WRITE, OTHER, REBOOT, data, 0);
+    if (!pin_interrupts)
+      return;
+    detachInterrupt(digitalPinToInterrupt(presence_pin));
+    detachInterrupt(digitalPinToInterrupt(motion_pin));
+    getPinValues(); // dispatch what is still queued
+    pin_interrupts = false;
   }
   void MR24HPB1::getPinValues()
   {
-    boolean curr_p = digitalRead(presence_pin);
-    boolean curr_m = digitalRead(motion_pin);
-
-    if (presence != curr_p)
-    { // edge detection
-      presence = curr_p;
-      std::function<void(void)> cb = (curr_p) ? _on_occupied : _on_unoccupied; // decide which callback to call
-      if (cb != NULL)
-        cb(); // call callback if registered
+    if (!pin_interrupts)
+    {
+      readPins();
+      return;
     }
-
-    if (motion != curr_m)
+    pin_edge_t edge;
+    while (pin_edges.pop(edge))
     {
-      motion = curr_m;
-      std::function<void(void)> cb = (curr_m) ? _on_movement : _on_stationary;
-      if (cb != NULL)
-        cb(); // call callback if registered
+      last_edge_at = edge.at;
+      if (edge.pin == presence_pin)
+        updatePresence(edge.level);
+      else
+        updateMotion(edge.level);
+    }
+    uint32_t dropped = pin_edges.takeDropped();
+    if (dropped > 0)
+    { // the queue no longer adds up to the pin levels
+      dropped_edges += dropped;
+      readPins();
     }
   }
-
-  // Helpers
-  uint16_t MR24HPB1::CRC16(uint8_t *Frame, uint8_t Len)
+  void MR24HPB1::readPins()
   {
-    unsigned char luc_CRCHi = 0xFF;
-    unsigned char luc_CRCLo = 0xFF;
-    int li_Index = 0;
-    while (Len--)
-    {
-      li_Index = luc_CRCLo ^ *(Frame++);
-      luc_CRCLo = (unsigned char)(luc_CRCHi ^ cuc_CRCHi[li_Index]);
-      luc_CRCHi = cuc_CRCLo[li_Index];
-    }
-    return (uint16_t)(luc_CRCLo << 8 | luc_CRCHi);
+    updatePresence(digitalRead(presence_pin));
+    updateMotion(digitalRead(motion_pin));
   }
-  uint16_t MR24HPB1::getMsg_length()
+  void MR24HPB1::queuePinEdge(uint8_t pin)
   {
-    uint16_t size = msg[1];
-    size = size << 8 | msg[0];
-    msg_size = size;
-    return size;
+    pin_edges.push(pin_edge_t{pin, (uint8_t)digitalRead(pin), (uint32_t)micros()}); // a full queue counts the drop
   }
-  uint16_t MR24HPB1::getData_length()
+  void MR24HPB1::updatePresence(boolean level)
   {
-    return getMsg_length() - 7;
+    if (presence_level == level)
+      return; // edge detection
+    presence_level = level;
+    presence = level;
+    std::function<void(void)> cb = (level) ? _on_occupied : _on_unoccupied; // decide which callback to call
+    if (cb != NULL)
+      cb(); // call callback if registered
   }
-  boolean MR24HPB1::verifyMsg(uint8_t *msg, uint8_t length)
+  void MR24HPB1::updateMotion(boolean level)
   {
+    if (motion_level == level)
+      return;
+    motion_level = level;
+    motion = level;
+    std::function<void(void)> cb = (level) ? _on_movement : _on_stationary;
+    if (cb != NULL)
+      cb(); // call callback if registered
+  }
 
-    uint16_t crc16_msg = msg[length - 2];
-    crc16_msg = crc16_msg << 8 | msg[length - 1];
-
-    uint8_t frame[length + 1];
-    frame[0] = 0x55;
-    for (int i = 1; i <= length; i++)
+  // Helpers
+  int MR24HPB1::requestWrite(cached_field_t field, uint8_t value)
+  {
+    if (write_state[field] == WRITE_PENDING && write_value[field] == value)
+      return 0; // already on its way, keep the backoff it has
+    write_state[field] = WRITE_PENDING;
+    write_value[field] = value;
+    write_started[field] = millis();
+    write_backoff[field] = write_retry;
+    write_stats.writes++;
+    sendWrite(field);
+    return 0;
+  }
+  void MR24HPB1::sendWrite(cached_field_t field)
+  {
+    uint8_t data[1] = {write_value[field]};
+    sendMsg(WRITE, SYSTEM_PARAM, field == CACHED_THRESHOLD ? THRESHOLD_GEAR : SCENE_SETTING, data, 1);
+    write_sent[field] = millis();
+  }
+  void MR24HPB1::serviceWrites()
+  {
+    uint32_t now = millis();
+    for (uint8_t field = 0; field < MR24HPB1_WRITABLE_FIELDS; field++)
     {
-      frame[i] = msg[i - 1];
+      if (write_state[field] != WRITE_PENDING)
+        continue;
+      if (now - write_started[field] >= write_deadline)
+      {
+        write_state[field] = WRITE_FAILED;
+        write_stats.failed++;
+      }
+      else if (now - write_sent[field] >= write_backoff[field])
+      { // no echo yet, the frame or its echo was lost
+        write_backoff[field] *= 2;
+        write_stats.retries++;
+        sendWrite((cached_field_t)field);
+      }
     }
-    uint16_t crc = CRC16(frame, length - 1);
-
-    return crc == crc16_msg;
+  }
+  int MR24HPB1::waitForWrite(cached_field_t field)
+  {
+    while (write_state[field] == WRITE_PENDING)
+      yield(2);
+    return write_state[field] == WRITE_CONFIRMED ? 0 : -2;
+  }
+  void MR24HPB1::cache(cached_field_t field)
+  {
+    cached_at[field] = millis();
+    cached_fields |= 1 << field;
+    if (field < MR24HPB1_WRITABLE_FIELDS && write_state[field] == WRITE_PENDING &&
+        (field == CACHED_THRESHOLD ? threshold : scene_setting) == write_value[field])
+    { // the passive report echoing the write
+      uint32_t latency = cached_at[field] - write_started[field];
+      write_state[field] = WRITE_CONFIRMED;
+      write_stats.confirmed++;
+      write_stats.last_latency = latency;
+      write_stats.total_latency += latency;
+      if (latency > write_stats.max_latency)
+        write_stats.max_latency = latency;
+    }
+    if ((startup_pending & (1 << field)) == 0)
+      return;
+    if ((field == CACHED_THRESHOLD && startup_threshold >= 0 && threshold != startup_threshold) ||
+        (field == CACHED_SCENE_SETTING && startup_scene >= 0 && scene_setting != startup_scene))
+      return; // the sensor has not applied the write yet
+    startup_pending &= ~(1 << field);
+    startup_confirmed |= 1 << field;
+    if (field == CACHED_ENVIRONMENTAL_STATE)
+      startup_first_state = cached_at[field] - startup_at;
   }
   void MR24HPB1::sendMsg(function_cmd_t fc, addr_cmd1_t cmd1, addr_cmd2_t cmd2, uint8_t *data, uint8_t data_length)
   {
-    uint8_t frame_length = data_length + 8;
-    uint8_t frame[frame_length];
-    frame[0] = HEADER;
-    frame[1] = lowByte(frame_length - 1); // length
-    frame[2] = highByte(frame_length - 1);
-    frame[3] = (uint8_t)fc;   // function code
-    frame[4] = (uint8_t)cmd1; // addres code 1
-    frame[5] = (uint8_t)cmd2; // address code 2
-    for (uint8_t i = 0; i < data_length; i++)
-    { // data if any
-      frame[i + 6] = data[i];
-    }
-    uint16_t crc = CRC16(frame, 6 + data_length);
-    frame[data_length + 6] = highByte(crc);
-    frame[data_length + 7] = lowByte(crc);
+    uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+    uint8_t frame_length = buildFrame(frame, fc, cmd1, cmd2, data, data_length);
     serial.write(frame, frame_length);
 #ifdef DEBUG
     Serial.print("Send: ");
@@ -218,230 +314,104 @@ namespace MR24HPB1
     Serial.println();
 #endif
   }
-  void MR24HPB1::betterRecieveMsg()
-  {
-    while (serial.available() > 0)
-    {
-      if (serial.read() == HEADER)
-      {
-        uint8_t dataLength = serial.read() + (serial.read() << 8);
-        DataFrameBuilder dataFrame;
-        for (int i = 0; i < dataLength - 2; i++)
-        {
-          dataFrame.bytes[i] = serial.read();
-        }
-      }
-    }
-  }
   void MR24HPB1::recieveMsg()
   {
-    static boolean recieving = false;
-    static uint8_t index = 0;
-    static uint8_t data_len = 12;
-    uint8_t r_byte; // recieved byte
-    // Serial.println(serial.available());
-    while (serial.available() > 0 && newData == false)
-    {
-      r_byte = serial.read();
-      if (recieving)
-      { // recieved Header
-        if (data_len > index)
-        { // length in range
-          msg[index] = r_byte;
-          if (index == 0)
-          {
-            data_len = msg[0]; // Get length frame
-            msg_size = data_len;
-          }
-          index++;
-        }
-        else
-        {
-          recieving = false;
-          index = 0;
-          newData = true;
-        }
-      }
-      else if (r_byte == HEADER)
-      {                   // detected Header byte
-        recieving = true; // start reading
-      }
+    int pending = serial.available();
+    if (newData == false && assembler.receive(msg, serial, pending))
+    { // complete with a good CRC, corrupted frames are dropped by the assembler
+      msg_size = assembler.length();
+      newData = true;
     }
   }
-  void MR24HPB1::parseMsg()
-  {
-    // function_cmd_t FunctionCommand = (function_cmd_t) msg[2];
-    addr_cmd1_t ADDRESS1 = (addr_cmd1_t)msg[3];
-    addr_cmd2_t ADDRESS2 = (addr_cmd2_t)msg[4];
-    std::function<void(void)> cb;
-    switch (ADDRESS1)
-    { // function Codes
-    case MODULE_INFO:
-    {
-      // Not implemented (yet)
-      break;
-    }
-    case RADAR_INFO:
-    {
-      switch (ADDRESS2)
+  // Handlers for the shared route table, in Route::Kind order
+  template <>
+  const Dispatch<MR24HPB1>::Handler Dispatch<MR24HPB1>::handlers[Route::COUNT] = {
+      [](MR24HPB1 &sensor, const uint8_t *data) // THRESHOLD
       {
-      case ENVIRONMENTAL_STATUS:
+        sensor.updated_member = THRESHOLD_GEAR;
+        if (data[0] > 10)
+          return;
+        sensor.threshold = data[0];
+        sensor.cache(CACHED_THRESHOLD);
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // SCENE
       {
-        updated_member = ENVIRONMENTAL_STATUS;
-        std::function<void(uint8_t)> _cb = _on_environmental_state;
-        auto prev = environmental_state;
-        auto new_ = prev;
-        if (msg[5] == 0x00 && msg[6] == 0xFF && msg[7] == 0xFF)
-        {
-          new_ = (uint8_t)UNOCCUPIED;
-          presence = false;
-          motion = false;
-        }
-        else if (msg[5] == 0x01 && msg[6] == 0x00 && msg[7] == 0xFF)
-        {
-          new_ = (uint8_t)STATIONARY;
-          presence = true;
-          motion = false;
-        }
-        else if (msg[5] == 0x01 && msg[6] == 0x01 && msg[7] == 0x01)
-        {
-          new_ = (uint8_t)EXERCISING;
-          presence = true;
-          motion = true;
-        }
-        else
-          _cb = NULL;
-
-        if (new_ != prev)
-        {
-          environmental_state = new_;
-          if (_cb != NULL)
-            _cb((uint8_t)environmental_state);
-        }
-
-        break;
-      } // end environmental state
-      case MOTOR_SIGNS:
+        if (data[0] > HOTEL)
+          return;
+        sensor.scene_setting = data[0];
+        sensor.cache(CACHED_SCENE_SETTING);
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // ENVIRONMENT
       {
-        updated_member = MOTOR_SIGNS;
-        std::function<void(float)> _cb = _on_motor_signs;
-        FB signs;
-
-        signs.B[0] = msg[5];
-        signs.B[1] = msg[6];
-        signs.B[2] = msg[7];
-        signs.B[3] = msg[8];
-        if (signs.F >= motor_signs + 1 || signs.F <= motor_signs - 1)
+        sensor.updated_member = ENVIRONMENTAL_STATUS;
+        int8_t state = Decode::environment(data);
+        if (state < 0)
+          return;
+        sensor.cache(CACHED_ENVIRONMENTAL_STATE);
+        sensor.presence = state != UNOCCUPIED;
+        sensor.motion = state == EXERCISING;
+        if (state != sensor.environmental_state)
         {
-          motor_signs = signs.F;
-          if (_cb != NULL)
-            _cb(signs.F);
+          sensor.environmental_state = state;
+          if (sensor._on_environmental_state != NULL)
+            sensor._on_environmental_state((uint8_t)state);
         }
-
-#ifdef DEBUG
-        for (int i = 0; i < msg_size; i++)
-        {
-          Serial.print(" ");
-          Serial.print(msg[i], HEX);
-        }
-        Serial.print(" f: ");
-        Serial.println(signs.F);
-#endif
-        break;
-      } // end Motor signs
-      case APPROACHING_AWAY_STATE:
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // MOTOR_SIGNS
       {
-        std::function<void(uint8_t)> _cb = _on_away_state;
-        updated_member = APPROACHING_AWAY_STATE;
-        if (msg[5] == 0x01 && msg[6] == 0x01)
+        sensor.updated_member = MOTOR_SIGNS;
+        float signs = Decode::motorSigns(data);
+        sensor.cache(CACHED_MOTOR_SIGNS);
+        if (signs >= sensor.motor_signs + 1 || signs <= sensor.motor_signs - 1)
         {
-          switch (msg[7])
-          {
-          case 0x01:
-            away_state = (uint8_t)NONE;
-            break;
-          case 0x02:
-            away_state = (uint8_t)CLOSE_TO;
-            break;
-          case 0x03:
-            away_state = (uint8_t)STAY_AWAY;
-            break;
-          default:
-            _cb = NULL;
-          }
-          if (_cb != NULL)
-            _cb(away_state); // call callback if registered
+          sensor.motor_signs = signs;
+          if (sensor._on_motor_signs != NULL)
+            sensor._on_motor_signs(signs);
         }
-
-        break;
-      } // end of away state
-
-      } // end of Radar Info
-      break;
-    } // end Radar Info
-    case SYSTEM_PARAM:
-    {
-      switch (ADDRESS2)
-      {
-      case THRESHOLD_GEAR:
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // APPROACH_AWAY
       {
-        updated_member = THRESHOLD_GEAR;
-        threshold = (msg[5] >= 0 && msg[5] <= 10) ? msg[5] : threshold;
-        break;
-      } // end Threshold
-      case SCENE_SETTING:
+        sensor.updated_member = APPROACHING_AWAY_STATE;
+        int8_t state = Decode::approachAway(data);
+        if (state < 0)
+          return;
+        sensor.cache(CACHED_AWAY_STATE);
+        sensor.away_state = state;
+        if (sensor._on_away_state != NULL)
+          sensor._on_away_state(sensor.away_state); // call callback if registered
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // HEARTBEAT
       {
-        scene_setting = (msg[5] > 0 && msg[5] <= 6) ? msg[5] : scene_setting;
-        break;
-      } // end scene setting
-      } // end of address code 2
-      break;
-    } // end system Parameters
-    case OTHER:
-    {
-      switch (ADDRESS2)
-      {
-      case HEARTBEAT:
+        sensor.updated_member = ENVIRONMENTAL_STATUS;
+        int8_t state = Decode::environment(data);
+        if (state < 0)
+          return;
+        sensor.cache(CACHED_ENVIRONMENTAL_STATE);
+        sensor.environmental_state = state;
+        if (sensor._on_environmental_state != NULL)
+          sensor._on_environmental_state((uint8_t)state);
+      },
+      [](MR24HPB1 &sensor, const uint8_t *data) // ABNORMAL_RESET
       {
-        updated_member = ENVIRONMENTAL_STATUS;
-        std::function<void(uint8_t)> _cb = _on_environmental_state;
-        if (msg[5] == 0x00 && msg[6] == 0xFF && msg[7] == 0xFF)
-        {
-          environmental_state = (uint8_t)UNOCCUPIED;
-        }
-        else if (msg[5] == 0x01 && msg[6] == 0x00 && msg[7] == 0xFF)
-        {
-          environmental_state = (uint8_t)STATIONARY;
-        }
-        else if (msg[5] == 0x01 && msg[6] == 0x01 && msg[7] == 0x01)
-        {
-          environmental_state = (uint8_t)EXERCISING;
-        }
-        else
-          _cb = NULL;
+        if (Decode::abnormalReset(data))
+          sensor.abnormalResets++;
+      },
+  };
 
-        if (_cb != NULL)
-          _cb((uint8_t)environmental_state);
-        break;
-      } // end of heartbeat
-      case ABNORMAL_RESET:
-      {
-        if (msg[5] == 0x0F)
-          abnormalResets++;
-        break;
-      }
-      } // end of address code 2
-      break;
-    } // end of other funct
-    default:
+  void MR24HPB1::parseMsg()
+  {
+    if (!Dispatch<MR24HPB1>::dispatch(*this, FrameView{msg, msg_size}))
+    {
+#ifdef DEBUG
+      Serial.print("Unhandled: ");
       for (int i = 0; i < msg_size; i++)
       {
         Serial.print(" 0x");
         Serial.print(msg[i], HEX);
       }
       Serial.println();
-      break;
-    } // end of function codes
+#endif
+    }
   }
   void MR24HPB1::yield(long Delay)
   {
@@ -454,35 +424,56 @@ namespace MR24HPB1
   }
   int MR24HPB1::begin(uint8_t threshold, scene_setting_t scene)
   {
-
-    setThreshold(threshold);
-    yield(100);
-    setSceneSetting(scene);
-    yield(100);
-    getEnvironmentalState();
-    yield(100);
-    getMotorSigns();
-    return 0;
+    if (!validThreshold(threshold) || !validScene(scene))
+      return -1; // nothing sent, as setThreshold() and setSceneSetting() do
+    startup(threshold, scene);
+    while (starting)
+      yield(2);
+    return startup_pending == 0 ? 0 : -2;
   }
   int MR24HPB1::begin()
   {
-
-    getThreshold();
-    yield(100);
-    getSceneSetting();
-    yield(100);
-    getEnvironmentalState();
-    yield(100);
-    getMotorSigns();
-
-    return 0;
+    startup();
+    while (starting)
+      yield(2);
+    return startup_pending == 0 ? 0 : -2;
+  }
+  void MR24HPB1::startup(uint32_t deadline)
+  {
+    startup_threshold = -1;
+    startup_scene = -1;
+    sendStartup(deadline);
+  }
+  void MR24HPB1::startup(uint8_t threshold, scene_setting_t scene, uint32_t deadline)
+  {
+    // retried until the sensor echoes them, a value out of range is only read
+    startup_threshold = requestThreshold(threshold) == 0 ? threshold : -1;
+    startup_scene = requestSceneSetting(scene) == 0 ? scene : -1;
+    sendStartup(deadline);
+  }
+  void MR24HPB1::sendStartup(uint32_t deadline)
+  {
+    starting = true;
+    startup_at = millis();
+    startup_deadline = deadline;
+    startup_pending = (1 << CACHED_THRESHOLD) | (1 << CACHED_SCENE_SETTING) | (1 << CACHED_ENVIRONMENTAL_STATE) | (1 << CACHED_MOTOR_SIGNS);
+    startup_confirmed = 0;
+    startup_first_state = MR24HPB1_NEVER;
+    if (startup_threshold < 0)
+      requestRefresh(CACHED_THRESHOLD);
+    if (startup_scene < 0)
+      requestRefresh(CACHED_SCENE_SETTING);
+    requestRefresh(CACHED_ENVIRONMENTAL_STATE);
+    requestRefresh(CACHED_MOTOR_SIGNS);
   }
   void MR24HPB1::refresh()
   {
     getPinValues(); // Get current state for fast reaction
+    if (starting && (startup_pending == 0 || millis() - startup_at >= startup_deadline))
+      starting = false;
+    serviceWrites();
     recieveMsg();   // Get serial data into array
-    bool is_valid = verifyMsg(msg, msg_size);
-    if (is_valid && newData)
+    if (newData) // CRC was checked as the frame arrived, nothing to do without a new one
     {
       parseMsg();
     }
@@ -4,11 +4,20 @@
 #include <functional>
 #include "Arduino.h"
 #include "MR24HPB1_def.h"
+#include "MR24HPB1_protocol.h"
+#include "../../Util/RingBuffer.h"
+
+#define MR24HPB1_FRAME_POOL_SIZE 4 // Frames Radar can hold between receiving and processing them
+#define MR24HPB1_FRAME_BUDGET 8 // Frames Radar::loop() processes per call by default
+#define MR24HPB1_NEVER 0xFFFFFFFF // Age of a value the sensor has not reported yet
+#define MR24HPB1_STARTUP_DEADLINE 1000 // Milliseconds begin() waits for the sensor to answer every startup query
+#define MR24HPB1_WRITE_DEADLINE 1000 // Milliseconds a write has to be echoed before it fails
+#define MR24HPB1_WRITE_RETRY 50 // Milliseconds before the first resend, doubling after each one
+#define MR24HPB1_WRITABLE_FIELDS 2 // CACHED_THRESHOLD and CACHED_SCENE_SETTING, the settings the sensor accepts writes for
+#define MR24HPB1_PIN_EDGE_BUFFER_LENGTH 16 // S1/S2 edges the interrupts can queue between refresh() calls, a power of two
 
 namespace MR24HPB1
 {
-    uint16_t getCRC16(uint8_t *Frame, uint8_t Len);
-
     struct Scene
     {
         enum Name
@@ -57,14 +66,6 @@ namespace MR24HPB1
         };
     };
 
-    struct DataFrame
-    {
-        uint8_t commandFunction;
-        uint8_t address1;
-        uint8_t address2;
-        uint8_t data[];
-    };
-
     struct Command {
         enum Function {
             READ = 0x01,
@@ -74,21 +75,19 @@ namespace MR24HPB1
         };
     };
 
-    typedef union
-    {
-        DataFrame dataFrame;
-        uint8_t bytes[sizeof(DataFrame)];
-    } DataFrameBuilder;
-
     typedef std::function<void(Occupancy::State)> OccupancyCallback;
     typedef std::function<void(Motion::State)> MotionCallback;
     typedef std::function<void(Direction::State)> DirectionCallback;
 
 
-    class Radar
+    /*
+     * Radar's state and report handling, everything that does not touch the transport. The frames are received by
+     * BasicRadar below.
+     */
+    class RadarCore
     {
     private:
-        HardwareSerial &serial;
+        friend struct Dispatch<RadarCore>; // Report handlers apply decoded values through the private setters
         Scene::Name _activeScene = Scene::UNKNOWN;
         uint8_t _threshold = 7;
         Occupancy::State _occupancyState = Occupancy::UNKNOWN;
@@ -104,23 +103,134 @@ namespace MR24HPB1
         void setDirection(Direction::State);
         void setScene(Scene::Name);
         void setThreshold(uint8_t);
+    protected:
+        struct FrameSlot
+        {
+            uint8_t bytes[MR24HPB1_MAX_FRAME_LENGTH];
+            uint8_t length = 0;
+        };
+        FrameSlot _framePool[MR24HPB1_FRAME_POOL_SIZE]; // Frames are received straight into these, nothing is allocated
+        uint8_t _frameHead = 0; // Oldest frame waiting for process()
+        uint8_t _frameCount = 0;
+        FrameAssembler _assembler; // Keeps a partly received frame across loop() calls
+        uint8_t _frameBudget = MR24HPB1_FRAME_BUDGET;
 
-        DataFrameBuilder* parseFrame();
+        FrameSlot *freeFrame(); // Slot the next frame is received into, nullptr while the pool is full
+        FrameView nextFrame(); // Oldest received frame
+        void releaseFrame(); // Return the oldest frame's slot to the pool
+        void process(const FrameView &);
+        void processFrames(uint8_t &processed); // Up to the frame budget from the pool, counted in processed
+    public:
+        void setFrameBudget(uint8_t frames); // Bound the work done per loop(), the rest waits for the next call
+
+        void registerOccupancyCallback(OccupancyCallback);
+        void registerMotionCallback(MotionCallback);
+        void registerDirectionCallback(DirectionCallback);
+    };
+
+    /*
+     * The MR24HPB1 driver over any transport with int available(), int read() returning -1 when empty and
+     * write(const uint8_t *, size_t), such as a UART, a DMA ring, a replay file or a simulator. A concrete transport
+     * gets its calls inlined into the receive loop, Radar below is the Stream build.
+     */
+    template <class Transport>
+    class BasicRadar : public RadarCore
+    {
+    private:
+        Transport &serial;
+        HardwareSerial *uart = nullptr; // Set when constructed on a UART, so setup() can start it
+
+        bool assembleFrame(int &pending); // Feed up to pending bytes into the next free slot, true once a frame with a good CRC completes
         void readSettingss();
-        void process(DataFrame);
         void send(uint8_t, uint8_t, uint8_t, uint8_t* = nullptr, uint8_t = 0);
+    protected:
+        BasicRadar(Transport &transport, HardwareSerial *serialPort) : serial(transport), uart(serialPort) {}
     public:
-        Radar(HardwareSerial &serialPort);
-        ~Radar();
+        BasicRadar(Transport &transport) : serial(transport) {}
         void setup(uint8_t* = nullptr, uint8_t* = nullptr);
-        void loop();
+        void loop(); // Receive into the frame pool and process in batches, up to the frame budget
 
         void configureScene(Scene::Name);
         void configureThreshold(uint8_t);
+    };
 
-        void registerOccupancyCallback(OccupancyCallback);
-        void registerMotionCallback(MotionCallback);
-        void registerDirectionCallback(DirectionCallback);
+    template <class Transport>
+    void BasicRadar<Transport>::setup(uint8_t *presencePin, uint8_t *motionPin)
+    {
+        if (presencePin != nullptr)
+            pinMode(*presencePin, INPUT_PULLUP);
+        if (motionPin != nullptr)
+            pinMode(*motionPin, INPUT_PULLUP);
+        if (uart != nullptr)
+            uart->begin(9600);
+    }
+
+    template <class Transport>
+    void BasicRadar<Transport>::loop()
+    {
+        int pending = serial.available(); // Only what has already arrived, so the call never waits on the UART
+        uint8_t processed = 0;
+        while (processed < _frameBudget)
+        {
+            // Receive until the pool is full or the bytes run out, then process that batch
+            while (assembleFrame(pending))
+            {
+            }
+            if (_frameCount == 0)
+                break;
+            processFrames(processed);
+        }
+    }
+
+    template <class Transport>
+    bool BasicRadar<Transport>::assembleFrame(int &pending)
+    {
+        FrameSlot *slot = freeFrame();
+        if (slot == nullptr)
+            return false; // Leave the bytes in the UART until process() frees a slot
+        if (!_assembler.receive(slot->bytes, serial, pending)) // Corrupted frames leave the slot to be reused for the next one
+            return false;
+        slot->length = _assembler.length();
+        _frameCount++;
+        return true;
+    }
+
+    template <class Transport>
+    void BasicRadar<Transport>::readSettingss()
+    {
+        send(Command::READ, 0x04, 0x0C);
+        send(Command::READ, 0x04, 0x10);
+    }
+
+    template <class Transport>
+    void BasicRadar<Transport>::send(uint8_t functionCode, uint8_t address1, uint8_t address2, uint8_t *data, uint8_t length)
+    {
+        uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+        uint8_t frameLength = buildFrame(frame, functionCode, address1, address2, data, length);
+        if (frameLength > 0)
+            serial.write(frame, frameLength);
+    }
+
+    template <class Transport>
+    void BasicRadar<Transport>::configureScene(Scene::Name scene)
+    {
+        uint8_t data = static_cast<uint8_t>(scene);
+        send(Command::WRITE, 0x04, 0x10, &data, 1);
+    }
+
+    template <class Transport>
+    void BasicRadar<Transport>::configureThreshold(uint8_t threshold)
+    {
+        send(Command::WRITE, 0x04, 0x0C, &threshold, 1);
+    }
+
+    extern template class BasicRadar<Stream>; // One copy in Radar.cpp
+
+    class Radar : public BasicRadar<Stream>
+    {
+    public:
+        Radar(HardwareSerial &serialPort) : BasicRadar(serialPort, &serialPort) {}
+        Radar(Stream &stream) : BasicRadar(stream) {} // Anything that speaks the protocol, such as the host build's Simulator
     };
 
     /*
@@ -138,6 +248,8 @@ namespace MR24HPB1
          * @Param pin_motion the pin the s2 pin is connected to
          */
         MR24HPB1(HardwareSerial &serialPort, uint8_t pin_presence, uint8_t pin_motion);
+        // As above but on a stream that is already running, such as the host build's Simulator
+        MR24HPB1(Stream &stream, uint8_t pin_presence, uint8_t pin_motion);
 
         /* Register some event handlers (optional) an Event callback is called whenever the refresh()
          */
@@ -154,9 +266,11 @@ namespace MR24HPB1
         *	Due to the execution of code the delays might not be exact.
         *	Do not use for critical timing.
             @Param Delay the delay in ms.
+            Only the blocking calls use it, firmware on a Scheduler uses startup() and the request functions instead.
         */
         void yield(long Delay);
         // refer to the datasheet or the MR24HPB1_def for interpretation
+        // The getters return the last value the sensor reported straight away, use getAge() and requestRefresh() when staleness matters
         uint8_t getMotionStatus();
         uint8_t getThreshold();
         uint8_t getSceneSetting();
@@ -168,16 +282,63 @@ namespace MR24HPB1
         // Returns the type of data that was updated last and 0xFF if no data was recieved between the last call and this call.
         uint8_t getUpdatedMemberType();
         away_state_t getAwayState();
+        // Milliseconds since the sensor last reported the field, MR24HPB1_NEVER if it has not yet
+        uint32_t getAge(cached_field_t field);
+        // Ask the sensor for the field without waiting, refresh() stores the reply
+        void requestRefresh(cached_field_t field);
+        // As above for every field
+        void requestRefresh();
 
         // configure the sensor refer to Datasheet and/or MR24HPB1_def for available settings
+        // Blocks until the sensor echoes the new value, 0, or the write deadline passes, -2. -1 for a value out of range.
         int setThreshold(uint8_t gear);
         int setSceneSetting(scene_setting_t scene);
         void Reboot();
 
+        /*
+         * Non-blocking writes. The write is resent with exponential backoff until a passive report echoes the new value
+         * or the deadline passes, refresh() does the work. Returns -1 for a value out of range, otherwise 0.
+         */
+        int requestThreshold(uint8_t gear);
+        int requestSceneSetting(scene_setting_t scene);
+        // WRITE_PENDING until the write confirms or fails, WRITE_IDLE for a field never written
+        write_state_t getWriteState(cached_field_t field);
+        void setWriteTimeouts(uint32_t deadline, uint16_t first_retry);
+        const write_stats_t &getWriteStats() { return write_stats; }
+
         // Initialize the sensor and its settings OPTIONAL
+        // Blocks until every setting is confirmed, 0, or the deadline passes, -2. -1 for a value out of range.
         int begin(uint8_t threshold, scene_setting_t scene);
         int begin();
 
+        /*
+         * Non-blocking startup. All queries go out back to back and refresh() collects the replies, until every one
+         * has arrived or deadline ms have passed.
+         */
+        void startup(uint32_t deadline = MR24HPB1_STARTUP_DEADLINE);
+        // As above, writing threshold and scene first. They only count as confirmed once the sensor reports the new values,
+        // a value out of range is read instead.
+        void startup(uint8_t threshold, scene_setting_t scene, uint32_t deadline = MR24HPB1_STARTUP_DEADLINE);
+        boolean startupComplete() { return !starting; }
+        // Bit per cached_field_t the sensor has answered since startup()
+        uint8_t getStartupConfirmed() { return startup_confirmed; }
+        // Milliseconds from startup() to the first environmental state report, MR24HPB1_NEVER until then
+        uint32_t getStartupTime() { return startup_first_state; }
+
+        /*
+         * Optional interrupt mode for the S1/S2 pins. Every edge is queued with its micros() timestamp and refresh()
+         * calls the pin callbacks in the order the edges happened, so none are lost between calls. Without it
+         * refresh() reads the pins each time. Returns false if an interrupt could not be attached.
+         */
+        boolean attachPinInterrupts();
+        void detachPinInterrupts();
+        // An edge is waiting for refresh(), cheap enough to check from a tight loop
+        boolean pinEdgesPending() { return !pin_edges.empty(); }
+        // micros() of the last edge refresh() dispatched
+        uint32_t getLastEdgeMicros() { return last_edge_at; }
+        // Edges lost to a full queue, the pins are read again whenever that happens
+        uint32_t getDroppedEdges() { return dropped_edges; }
+
         // Handles the recieving/updating of the sensor data. Needs to be called frequently. e.g in the loop() in the case of arduino
         void refresh();
 
@@ -185,23 +346,50 @@ namespace MR24HPB1
         int8_t away_state = -1, threshold = -1, scene_setting = -1, motion_pin = -1, presence_pin = -1;
         int8_t environmental_state = -1;
         uint8_t abnormalResets = 0;
-        uint8_t updated_member;
-        float motor_signs;
+        uint8_t updated_member = 0xFF;
+        float motor_signs = 0; // a replayed capture has to decode to the same callbacks every run
+        uint32_t cached_at[CACHED_FIELDS]; // millis() of each field's last report
+        uint8_t cached_fields = 0; // bit per field that has been reported at least once
+        boolean starting = false;
+        uint8_t startup_pending = 0, startup_confirmed = 0; // bit per cached_field_t
+        int8_t startup_threshold = -1, startup_scene = -1; // values startup() wrote, -1 when only read
+        uint32_t startup_at = 0, startup_deadline = 0, startup_first_state = MR24HPB1_NEVER;
+        // outstanding writes, indexed by cached_field_t
+        write_state_t write_state[MR24HPB1_WRITABLE_FIELDS] = {WRITE_IDLE, WRITE_IDLE};
+        uint8_t write_value[MR24HPB1_WRITABLE_FIELDS];
+        uint32_t write_started[MR24HPB1_WRITABLE_FIELDS], write_sent[MR24HPB1_WRITABLE_FIELDS];
+        uint32_t write_backoff[MR24HPB1_WRITABLE_FIELDS];
+        uint32_t write_deadline = MR24HPB1_WRITE_DEADLINE;
+        uint16_t write_retry = MR24HPB1_WRITE_RETRY;
+        write_stats_t write_stats = {};
         boolean presence = false, motion = false, newData = false;
-        uint8_t msg[30];
-        uint16_t msg_size;
+        boolean presence_level = false, motion_level = false; // last S1/S2 levels, the UART reports also set presence and motion
+        boolean pin_interrupts = false;
+        RingBuffer<pin_edge_t, MR24HPB1_PIN_EDGE_BUFFER_LENGTH> pin_edges; // pushed by the interrupts, drained by refresh()
+        uint32_t last_edge_at = 0, dropped_edges = 0;
+        uint8_t msg[MR24HPB1_MAX_FRAME_LENGTH]; // last frame recieved, header included
+        uint8_t msg_size = 0;
+        FrameAssembler assembler;
 
-        HardwareSerial &serial;
+        Stream &serial;
 
-        uint16_t CRC16(uint8_t *Frame, uint8_t Len);
-        uint16_t getMsg_length();
-        uint16_t getData_length();
         void getPinValues();
-        boolean verifyMsg(uint8_t *msg, uint8_t length); // msg should not iclude header
+        void readPins();
+        void queuePinEdge(uint8_t pin); // interrupt context
+        void updatePresence(boolean level);
+        void updateMotion(boolean level);
+        void cache(cached_field_t field);
+        void sendStartup(uint32_t deadline);
+        int requestWrite(cached_field_t field, uint8_t value);
+        void sendWrite(cached_field_t field);
+        void serviceWrites();
+        int waitForWrite(cached_field_t field);
+        static boolean validThreshold(uint8_t gear);
+        static boolean validScene(scene_setting_t scene);
         void sendMsg(function_cmd_t fc, addr_cmd1_t cmd1, addr_cmd2_t cmd2, uint8_t *data, uint8_t data_length);
         void recieveMsg();
-        void betterRecieveMsg();
         void parseMsg();
+        friend struct Dispatch<MR24HPB1>;
 
         // Store the callback functions so we can call them later
         std::function<void(void)> _on_unoccupied;
@@ -213,6 +401,11 @@ namespace MR24HPB1
         std::function<void(float)> _on_motor_signs;
     };
 
+    // Each driver's report handlers, defined in its .cpp
+    template <>
+    const Dispatch<RadarCore>::Handler Dispatch<RadarCore>::handlers[Route::COUNT];
+    template <>
+    const Dispatch<MR24HPB1>::Handler Dispatch<MR24HPB1>::handlers[Route::COUNT];
 };
 
 #endif
@@ -0,0 +1,31 @@
+#include "Arduino.h"
+#include "MR24HPB1_protocol.h"
+
+namespace MR24HPB1
+{
+    uint16_t getCRC16(const uint8_t *Frame, uint8_t Len)
+    {
+        return CRC16::compute(Frame, Len);
+    }
+
+    uint8_t buildFrame(uint8_t *frame, uint8_t function, uint8_t address1, uint8_t address2, const uint8_t *data, uint8_t dataLength)
+    {
+        if (dataLength > MR24HPB1_MAX_DATA_LENGTH)
+            return 0;
+        uint8_t frameLength = dataLength + 8;
+        frame[0] = HEADER;
+        frame[1] = lowByte(frameLength - 1); // The length counts everything after the header
+        frame[2] = highByte(frameLength - 1);
+        frame[3] = function;
+        frame[4] = address1;
+        frame[5] = address2;
+        for (uint8_t i = 0; i < dataLength; i++)
+            frame[6 + i] = data[i];
+        uint16_t crc = getCRC16(frame, 6 + dataLength);
+        frame[dataLength + 6] = highByte(crc);
+        frame[dataLength + 7] = lowByte(crc);
+        return frameLength;
+    }
+
+    template bool FrameAssembler::receive<Stream>(uint8_t *frame, Stream &stream, int &pending);
+};
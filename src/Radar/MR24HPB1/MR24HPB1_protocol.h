@@ -0,0 +1,313 @@
+#ifndef MR24HPB1_PROTOCOL_H
+#define MR24HPB1_PROTOCOL_H
+
+#include "Arduino.h"
+#include "MR24HPB1_def.h"
+
+#define MR24HPB1_MAX_DATA_LENGTH 22 // Largest payload the sensor sends
+#define MR24HPB1_MAX_FRAME_LENGTH (MR24HPB1_MAX_DATA_LENGTH + 8) // Header, length, function, addresses, payload and CRC
+#define MR24HPB1_ROUTE_INDEX_LENGTH 32 // Slots in the report index, a power of two
+
+#define MR24HPB1_CRC16_TABLE 0 // A byte per lookup into 512 bytes of flash
+#define MR24HPB1_CRC16_NIBBLE 1 // Two lookups per byte into 32 bytes of flash, for builds short of space
+#ifndef MR24HPB1_CRC16_IMPLEMENTATION
+#define MR24HPB1_CRC16_IMPLEMENTATION MR24HPB1_CRC16_TABLE
+#endif
+
+/*
+ * The framing, CRC and report decoding both drivers are built on. MR24HPB1 and Radar only differ in how they
+ * buffer frames and what they do with the decoded values.
+ */
+namespace MR24HPB1
+{
+    /*
+     * The sensor's CRC16 is Modbus CRC16 with the low byte sent first. The lookup table is generated at compile time
+     * in the size MR24HPB1_CRC16_IMPLEMENTATION selects. Start from INITIAL, update() each byte as it arrives and
+     * value() gives the same result as getCRC16().
+     */
+    namespace CRC16
+    {
+        constexpr uint16_t INITIAL = 0xFFFF;
+
+        constexpr uint16_t shift(uint16_t crc, uint8_t bits) // Clock bits zeros through the reflected 0x8005 polynomial
+        {
+            for (uint8_t i = 0; i < bits; i++)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+            return crc;
+        }
+
+        template <uint16_t Entries>
+        struct Table
+        {
+            uint16_t entry[Entries];
+        };
+
+        template <uint16_t Entries>
+        constexpr Table<Entries> buildTable(uint8_t bits)
+        {
+            Table<Entries> table = {};
+            for (uint16_t i = 0; i < Entries; i++)
+                table.entry[i] = shift(i, bits);
+            return table;
+        }
+
+#if MR24HPB1_CRC16_IMPLEMENTATION == MR24HPB1_CRC16_NIBBLE
+        inline constexpr Table<16> table = buildTable<16>(4);
+
+        constexpr uint16_t update(uint16_t crc, uint8_t byte)
+        {
+            crc ^= byte;
+            crc = (crc >> 4) ^ table.entry[crc & 0x0F];
+            return (crc >> 4) ^ table.entry[crc & 0x0F];
+        }
+#else
+        inline constexpr Table<256> table = buildTable<256>(8);
+
+        constexpr uint16_t update(uint16_t crc, uint8_t byte)
+        {
+            return (crc >> 8) ^ table.entry[(crc ^ byte) & 0xFF];
+        }
+#endif
+
+        constexpr uint16_t value(uint16_t crc) // High byte is the one sent first, as getCRC16() returns it
+        {
+            return (uint16_t)(crc << 8 | crc >> 8);
+        }
+
+        constexpr uint16_t compute(const uint8_t *bytes, uint8_t length)
+        {
+            uint32_t crc = INITIAL; // A full register, update() keeps it to 16 bits
+            while (length--)
+                crc = update(crc, *(bytes++));
+            return value(crc);
+        }
+
+        // Frames worked out with the hand written tables this replaced
+        constexpr uint8_t readThreshold[] = {0x55, 0x07, 0x00, 0x01, 0x04, 0x0C};
+        constexpr uint8_t exercising[] = {0x55, 0x0A, 0x00, 0x04, 0x03, 0x05, 0x01, 0x01, 0x01};
+        static_assert(compute(readThreshold, sizeof(readThreshold)) == 0xEADB, "MR24HPB1 CRC16 does not match the sensor");
+        static_assert(compute(exercising, sizeof(exercising)) == 0x9D04, "MR24HPB1 CRC16 does not match the sensor");
+    };
+
+    uint16_t getCRC16(const uint8_t *Frame, uint8_t Len); // CRC16::compute() out of line
+
+    // Header, length, function, addresses, data and CRC into frame, which needs MR24HPB1_MAX_FRAME_LENGTH bytes. Returns the frame length, 0 if data does not fit.
+    uint8_t buildFrame(uint8_t *frame, uint8_t function, uint8_t address1, uint8_t address2, const uint8_t *data, uint8_t dataLength);
+
+    /*
+     * A received frame in place, starting at the 0x55 header. Only valid while its buffer is left alone.
+     */
+    struct FrameView
+    {
+        const uint8_t *frame;
+        uint8_t length;
+
+        uint8_t function() const { return frame[3]; }
+        uint8_t address1() const { return frame[4]; }
+        uint8_t address2() const { return frame[5]; }
+        const uint8_t *data() const { return frame + 6; }
+        uint8_t dataLength() const { return length - 8; }
+    };
+
+    /*
+     * Reassembles frames from a stream, so a frame can arrive across any number of reads. The CRC is folded in as
+     * each byte arrives and checked when the last one lands, corrupted frames are dropped.
+     *
+     * The transport is a template parameter, anything with an int read() that returns -1 when empty. The Stream
+     * instantiation is compiled once in MR24HPB1_protocol.cpp, a concrete transport gets its read() inlined.
+     */
+    class FrameAssembler
+    {
+    public:
+        // Read up to pending bytes into frame, true as soon as it holds a complete frame. Pass the same buffer until then.
+        template <class Transport>
+        bool receive(uint8_t *frame, Transport &stream, int &pending)
+        {
+            uint8_t position = _position; // Locals so the loop stays in registers
+            uint8_t length = _length;
+            uint16_t crc = _crc;
+            bool complete = false;
+            while (pending > 0)
+            {
+                int value = stream.read();
+                pending--;
+                if (value < 0)
+                {
+                    pending = 0;
+                    break;
+                }
+                if (position == 0 && value != HEADER)
+                    continue; // Between frames, wait for the next header
+                frame[position++] = value;
+                if (position == 1)
+                    crc = CRC16::update(CRC16::INITIAL, value); // Seeded with the header
+                else if (position <= 3 || position <= length - 2)
+                    crc = CRC16::update(crc, value); // The CRC covers everything before its own two bytes
+                if (position == 3)
+                {
+                    uint16_t frameLength = (frame[1] | (frame[2] << 8)) + 1; // The length counts everything after the header
+                    if (frameLength < 8 || frameLength > MR24HPB1_MAX_FRAME_LENGTH)
+                        position = 0; // Not a length this sensor sends
+                    else
+                        length = frameLength;
+                }
+                else if (position > 3 && position == length)
+                {
+                    position = 0;
+                    uint16_t expected = CRC16::value(crc);
+                    if (frame[length - 2] == highByte(expected) && frame[length - 1] == lowByte(expected))
+                    {
+                        complete = true;
+                        break;
+                    }
+                }
+            }
+            _position = position;
+            _length = length;
+            _crc = crc;
+            return complete;
+        }
+        uint8_t length() const { return _length; } // Of the frame receive() last completed
+        bool idle() const { return _position == 0; } // Between frames
+    private:
+        uint8_t _position = 0;
+        uint8_t _length = 0;
+        uint16_t _crc = CRC16::INITIAL; // Of the frame so far, up to its CRC bytes
+    };
+    extern template bool FrameAssembler::receive<Stream>(uint8_t *frame, Stream &stream, int &pending);
+
+    /*
+     * Typed decoders for report payloads, shared by both drivers. data points at the first byte after address code 2.
+     */
+    namespace Decode
+    {
+        // Environment status and heartbeat payloads, as environmental_state_t or -1 for a pattern the sensor does not send
+        inline int8_t environment(const uint8_t *data)
+        {
+            if (data[0] == 0x00 && data[1] == 0xFF && data[2] == 0xFF)
+                return UNOCCUPIED;
+            if (data[0] == 0x01 && data[1] == 0x00 && data[2] == 0xFF)
+                return STATIONARY;
+            if (data[0] == 0x01 && data[1] == 0x01 && data[2] == 0x01)
+                return EXERCISING;
+            return -1;
+        }
+
+        inline float motorSigns(const uint8_t *data)
+        {
+            FB signs;
+            memcpy(signs.B, data, sizeof(signs.B));
+            return signs.F;
+        }
+
+        // Approaching/away payload, as away_state_t or -1
+        inline int8_t approachAway(const uint8_t *data)
+        {
+            if (data[0] != 0x01 || data[1] != 0x01 || data[2] < NONE || data[2] > STAY_AWAY)
+                return -1;
+            return data[2];
+        }
+
+        inline bool abnormalReset(const uint8_t *data)
+        {
+            return data[0] == 0x0F;
+        }
+    };
+
+    struct Route
+    {
+        enum Kind : uint8_t
+        {
+            THRESHOLD,
+            SCENE,
+            ENVIRONMENT,
+            MOTOR_SIGNS,
+            APPROACH_AWAY,
+            HEARTBEAT,
+            ABNORMAL_RESET,
+            COUNT
+        };
+
+        uint8_t function;
+        uint8_t address1;
+        uint8_t address2;
+        uint8_t dataLength; // Shortest payload the decoder reads
+        Kind kind;
+    };
+
+    // Every report either driver understands. Reads are answered with passive reports, the sensor volunteers active ones.
+    inline constexpr Route routes[] = {
+        {PASSIVE_REPORT, SYSTEM_PARAM, THRESHOLD_GEAR, 1, Route::THRESHOLD},
+        {PASSIVE_REPORT, SYSTEM_PARAM, SCENE_SETTING, 1, Route::SCENE},
+        {PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, 3, Route::ENVIRONMENT},
+        {PASSIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, 3, Route::ENVIRONMENT},
+        {PROACTIVE_REPORT, RADAR_INFO, MOTOR_SIGNS, 4, Route::MOTOR_SIGNS},
+        {PASSIVE_REPORT, RADAR_INFO, MOTOR_SIGNS, 4, Route::MOTOR_SIGNS},
+        {PROACTIVE_REPORT, RADAR_INFO, APPROACHING_AWAY_STATE, 3, Route::APPROACH_AWAY},
+        {PASSIVE_REPORT, RADAR_INFO, APPROACHING_AWAY_STATE, 3, Route::APPROACH_AWAY},
+        {PROACTIVE_REPORT, OTHER, HEARTBEAT, 3, Route::HEARTBEAT},
+        {PROACTIVE_REPORT, OTHER, ABNORMAL_RESET, 1, Route::ABNORMAL_RESET},
+    };
+
+    constexpr uint8_t routeSlot(uint8_t function, uint8_t address1, uint8_t address2)
+    {
+        return (address2 ^ (address1 << 2) ^ (function << 4)) & (MR24HPB1_ROUTE_INDEX_LENGTH - 1); // Distinct for every route above
+    }
+
+    struct RouteIndex
+    {
+        uint8_t entry[MR24HPB1_ROUTE_INDEX_LENGTH]; // routes position plus one, zero for an empty slot
+        bool collision;
+    };
+
+    constexpr RouteIndex buildRouteIndex()
+    {
+        RouteIndex index = {{0}, false};
+        for (uint8_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+        {
+            uint8_t slot = routeSlot(routes[i].function, routes[i].address1, routes[i].address2);
+            if (index.entry[slot] != 0)
+            {
+                index.collision = true;
+            }
+            index.entry[slot] = i + 1;
+        }
+        return index;
+    }
+
+    inline constexpr RouteIndex routeIndex = buildRouteIndex();
+    static_assert(!routeIndex.collision, "Two MR24HPB1 routes share an index slot, change routeSlot()");
+
+    inline const Route *findRoute(uint8_t function, uint8_t address1, uint8_t address2)
+    {
+        uint8_t entry = routeIndex.entry[routeSlot(function, address1, address2)];
+        if (entry == 0)
+            return nullptr;
+        const Route &route = routes[entry - 1];
+        if (route.function != function || route.address1 != address1 || route.address2 != address2)
+            return nullptr;
+        return &route;
+    }
+
+    /*
+     * Each driver defines handlers, one per Route::Kind, that take the decoded value and apply it to its own state.
+     */
+    template <class Driver>
+    struct Dispatch
+    {
+        typedef void (*Handler)(Driver &driver, const uint8_t *data);
+        static const Handler handlers[Route::COUNT]; // Indexed by Route::Kind, null where the driver ignores the report
+
+        // False when the report is unknown, too short or ignored by this driver
+        static bool dispatch(Driver &driver, const FrameView &frame)
+        {
+            const Route *route = findRoute(frame.function(), frame.address1(), frame.address2());
+            if (route == nullptr || frame.dataLength() < route->dataLength || handlers[route->kind] == nullptr)
+                return false;
+            handlers[route->kind](driver, frame.data());
+            return true;
+        }
+    };
+};
+
+#endif
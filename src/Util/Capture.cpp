@@ -0,0 +1,276 @@
+#include "Capture.h"
+
+Capture::Capture(Stream &stream, bool captureWrites) : _stream(stream), _captureWrites(captureWrites)
+{
+}
+
+int Capture::read()
+{
+    int value = _stream.read();
+    if (value >= 0 && _capturing && record(value, false))
+    {
+        _stats.received++;
+    }
+    return value;
+}
+
+size_t Capture::write(uint8_t byte)
+{
+    if (_capturing && _captureWrites && record(byte, true))
+    {
+        _stats.sent++;
+    }
+    return _stream.write(byte);
+}
+
+size_t Capture::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = _stream.write(buffer, size);
+    if (_capturing && _captureWrites)
+    {
+        for (size_t i = 0; i < written; i++)
+        {
+            if (record(buffer[i], true))
+            {
+                _stats.sent++;
+            }
+        }
+    }
+    return written;
+}
+
+void Capture::start()
+{
+    const uint8_t header[CAPTURE_HEADER_LENGTH] = {'R', 'C', 'A', 'P', CAPTURE_VERSION, CAPTURE_TICK_MICROS & 0xFF, CAPTURE_TICK_MICROS >> 8};
+    _capturing = true;
+    _last = micros();
+    _droppedRun = 0;
+    if (!queue(header, sizeof(header)))
+    {
+        _stats.dropped++;
+        _droppedRun = 1; // The replay will not recognise this log, but the marker records why
+    }
+}
+
+size_t Capture::drain(Print &sink, size_t maxBytes)
+{
+    uint8_t chunk[CAPTURE_DRAIN_CHUNK];
+    size_t drained = 0;
+    while (drained < maxBytes)
+    {
+        uint16_t length = _log.peek(chunk, maxBytes - drained < sizeof(chunk) ? maxBytes - drained : sizeof(chunk));
+        if (length == 0)
+        {
+            break;
+        }
+        size_t written = sink.write(chunk, length);
+        _log.discard(written); // Only what the sink took, so an entry is never split from its head byte
+        drained += written;
+        _stats.drained += written;
+        if (written < length)
+        {
+            break; // The sink is full, the rest waits for the next drain()
+        }
+    }
+    return drained;
+}
+
+bool Capture::record(uint8_t byte, bool sent)
+{
+    uint8_t entry[9]; // Dropped marker, long gap head and the byte
+    uint8_t length = 0;
+    if (_droppedRun > 0)
+    {
+        entry[length++] = CAPTURE_DROPPED;
+        entry[length++] = _droppedRun & 0xFF;
+        entry[length++] = _droppedRun >> 8;
+    }
+    uint32_t gap = micros() - _last;
+    uint32_t ticks = gap / CAPTURE_TICK_MICROS;
+    uint32_t advance = ticks * CAPTURE_TICK_MICROS; // The remainder carries into the next gap so time does not drift
+    uint8_t head = sent ? CAPTURE_TX : 0;
+    if (ticks < CAPTURE_LONG_GAP)
+    {
+        entry[length++] = head | ticks;
+    }
+    else
+    {
+        entry[length++] = head | CAPTURE_LONG_GAP;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            entry[length++] = gap >> (8 * i);
+        }
+        advance = gap;
+    }
+    entry[length++] = byte;
+    if (!queue(entry, length))
+    {
+        _stats.dropped++;
+        if (_droppedRun < 0xFFFF)
+        {
+            _droppedRun++;
+        }
+        return false;
+    }
+    _droppedRun = 0;
+    _last += advance;
+    return true;
+}
+
+bool Capture::queue(const uint8_t *bytes, uint8_t length)
+{
+    if (CAPTURE_BUFFER_LENGTH - _log.size() < length)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _log.push(bytes[i]);
+    }
+    return true;
+}
+
+CaptureReplay::CaptureReplay(const uint8_t *log, size_t length, Mode mode) : _log(log), _length(length), _mode(mode)
+{
+    _valid = length >= CAPTURE_HEADER_LENGTH && log[0] == 'R' && log[1] == 'C' && log[2] == 'A' && log[3] == 'P' && log[4] == CAPTURE_VERSION;
+    if (!_valid)
+    {
+        _length = 0;
+        return;
+    }
+    _tick = log[5] | (log[6] << 8);
+    Cursor cursor;
+    cursor.position = CAPTURE_HEADER_LENGTH;
+    uint8_t byte;
+    while (nextReceived(cursor, byte, nullptr))
+    {
+        _received++;
+    }
+    restart();
+}
+
+void CaptureReplay::restart()
+{
+    _read = Cursor();
+    _read.position = _valid ? CAPTURE_HEADER_LENGTH : 0;
+    _release = _read;
+    _released = 0;
+    _elapsed = 0;
+    _lastCheck = micros();
+    _stats = Stats();
+}
+
+int CaptureReplay::available()
+{
+    if (_mode == FAST)
+    {
+        return _received - _stats.delivered;
+    }
+    release();
+    return _released;
+}
+
+int CaptureReplay::read()
+{
+    uint8_t byte;
+    if (available() == 0 || !nextReceived(_read, byte, &_stats.dropped))
+    {
+        return -1;
+    }
+    if (_mode == ORIGINAL_TIMING)
+    {
+        _released--;
+    }
+    _stats.delivered++;
+    return byte;
+}
+
+int CaptureReplay::peek()
+{
+    Cursor cursor = _read;
+    uint8_t byte;
+    if (available() == 0 || !nextReceived(cursor, byte, nullptr))
+    {
+        return -1;
+    }
+    return byte;
+}
+
+size_t CaptureReplay::write(uint8_t)
+{
+    _stats.written++;
+    return 1;
+}
+
+bool CaptureReplay::nextReceived(Cursor &cursor, uint8_t &byte, uint32_t *dropped)
+{
+    while (cursor.position < _length)
+    {
+        uint8_t head = _log[cursor.position];
+        uint8_t code = head & ~CAPTURE_TX;
+        uint32_t gap;
+        size_t data;
+        if (code == CAPTURE_DROPPED)
+        {
+            if (cursor.position + 3 > _length)
+            {
+                break;
+            }
+            if (dropped != nullptr)
+            {
+                *dropped += _log[cursor.position + 1] | (_log[cursor.position + 2] << 8);
+            }
+            cursor.position += 3;
+            continue;
+        }
+        if (code == CAPTURE_LONG_GAP)
+        {
+            data = cursor.position + 5;
+            if (data >= _length)
+            {
+                break;
+            }
+            gap = 0;
+            for (uint8_t i = 0; i < 4; i++)
+            {
+                gap |= (uint32_t)_log[cursor.position + 1 + i] << (8 * i);
+            }
+        }
+        else
+        {
+            data = cursor.position + 1;
+            if (data >= _length)
+            {
+                break;
+            }
+            gap = code * _tick;
+        }
+        cursor.position = data + 1;
+        cursor.time += gap;
+        if ((head & CAPTURE_TX) == 0)
+        {
+            byte = _log[data];
+            return true;
+        }
+    }
+    cursor.position = _length; // A truncated entry ends the log
+    return false;
+}
+
+void CaptureReplay::release()
+{
+    uint32_t now = micros();
+    _elapsed += now - _lastCheck;
+    _lastCheck = now;
+    uint8_t byte;
+    while (true)
+    {
+        Cursor cursor = _release;
+        if (!nextReceived(cursor, byte, nullptr) || cursor.time > _elapsed)
+        {
+            break;
+        }
+        _release = cursor;
+        _released++;
+    }
+}
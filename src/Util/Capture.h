@@ -0,0 +1,129 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "Arduino.h"
+#include "RingBuffer.h"
+
+#define CAPTURE_BUFFER_LENGTH 1024 // Bytes of log held in RAM until drain(), a power of two
+#define CAPTURE_TICK_MICROS 100 // Resolution of the gap stored before each byte
+#define CAPTURE_DRAIN_CHUNK 32 // Most bytes handed to the sink per write()
+
+/*
+ * Capture log format, little endian:
+ *   header  'R' 'C' 'A' 'P', version, tick in microseconds (2 bytes)
+ *   entries one per byte, a head byte then the data byte
+ * The head's top bit marks a byte the driver sent (CAPTURE_TX), the low 7 bits are the gap since the previous entry
+ * in ticks. CAPTURE_LONG_GAP is followed by the gap in microseconds (4 bytes) instead. CAPTURE_DROPPED is followed
+ * by the number of entries lost to a full buffer (2 bytes) and has no data byte.
+ */
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_LENGTH 7
+#define CAPTURE_TX 0x80
+#define CAPTURE_LONG_GAP 0x7E
+#define CAPTURE_DROPPED 0x7F
+
+/*
+ * Records the raw bytes of a radar link. Sits between a driver and its UART as a Stream, passing everything through
+ * and logging each byte with its timing into a RAM ring. drain() moves the log into any Print, such as a TCPClient,
+ * a file or a serial port, whenever there is time. Entries that do not fit are counted and marked in the log.
+ */
+class Capture : public Stream
+{
+public:
+    struct Stats
+    {
+        uint32_t received = 0; // Bytes from the sensor that were logged
+        uint32_t sent = 0; // Bytes from the driver that were logged
+        uint32_t dropped = 0; // Entries that did not fit
+        uint32_t drained = 0; // Log bytes handed to a sink
+    };
+
+    Capture(Stream &stream, bool captureWrites = true);
+    int available() override { return _stream.available(); }
+    int read() override;
+    int peek() override { return _stream.peek(); }
+    void flush() override { _stream.flush(); }
+    size_t write(uint8_t byte) override;
+    size_t write(const uint8_t *buffer, size_t size) override; // Logged byte by byte, forwarded in one call
+    using Print::write;
+
+    void start(); // Queue a header and log from here on, the gaps restart from now
+    void stop() { _capturing = false; }
+    bool capturing() const { return _capturing; }
+    size_t drain(Print &sink, size_t maxBytes = 0xFFFF); // Log bytes written to sink, what it does not take stays queued
+    uint16_t pending() const { return _log.size(); } // Log bytes waiting for drain()
+    const Stats &stats() const { return _stats; }
+
+private:
+    Stream &_stream;
+    RingBuffer<uint8_t, CAPTURE_BUFFER_LENGTH> _log;
+    uint32_t _last = 0; // micros() the gaps count from
+    uint16_t _droppedRun = 0; // Entries lost since the last one that fitted
+    bool _capturing = false;
+    bool _captureWrites;
+    Stats _stats;
+
+    bool record(uint8_t byte, bool sent);
+    bool queue(const uint8_t *bytes, uint8_t length); // All of them or none
+};
+
+/*
+ * Plays a capture log back as a Stream, so a driver can run on it in place of the UART, on the device or on a host
+ * with an Arduino core. ORIGINAL_TIMING releases each byte once its gap has passed on micros(). FAST releases
+ * everything at once, so the output depends only on the log and runs are reproducible. Writes from the driver are
+ * accepted and counted, the sent bytes in the log are skipped.
+ */
+class CaptureReplay : public Stream
+{
+public:
+    enum Mode
+    {
+        ORIGINAL_TIMING,
+        FAST
+    };
+
+    struct Stats
+    {
+        uint32_t delivered = 0; // Bytes the driver has read
+        uint32_t written = 0; // Bytes the driver wrote
+        uint32_t dropped = 0; // Entries the capture lost, from its markers
+    };
+
+    CaptureReplay(const uint8_t *log, size_t length, Mode mode = FAST);
+    bool valid() const { return _valid; } // The header was recognised
+    bool finished() const { return _stats.delivered >= _received; } // Every byte from the sensor delivered
+    void restart(); // From the first entry, timing from now
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override {}
+    size_t write(uint8_t byte) override;
+    using Print::write;
+    uint32_t received() const { return _received; } // Bytes from the sensor in the whole log
+    const Stats &stats() const { return _stats; }
+
+private:
+    struct Cursor
+    {
+        size_t position = 0;
+        uint64_t time = 0; // Microseconds from the start of the log
+    };
+
+    const uint8_t *_log;
+    size_t _length;
+    Mode _mode;
+    bool _valid = false;
+    uint16_t _tick = CAPTURE_TICK_MICROS;
+    uint32_t _received = 0;
+    Cursor _read; // Next entry read() decodes
+    Cursor _release; // Next entry that has not come due
+    uint32_t _released = 0; // Received bytes due but not yet read
+    uint64_t _elapsed = 0; // Microseconds since restart()
+    uint32_t _lastCheck = 0;
+    Stats _stats;
+
+    bool nextReceived(Cursor &cursor, uint8_t &byte, uint32_t *dropped); // Step to the next byte from the sensor, false at the end
+    void release(); // Count the bytes that have come due
+};
+
+#endif // CAPTURE_H
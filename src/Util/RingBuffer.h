@@ -0,0 +1,87 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Fixed capacity single-producer/single-consumer ring buffer.
+ * push() and pop() never block or allocate, so one side may run in an interrupt handler.
+ * Capacity must be a power of two; the indexes run freely and are masked, so every slot is usable.
+ * A push onto a full buffer is dropped and counted.
+ */
+template <typename T, uint16_t Capacity>
+class RingBuffer
+{
+    static_assert(Capacity > 0 && Capacity <= 0x8000 && (Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+public:
+    bool push(const T &item)
+    {
+        uint16_t head = _head.load(std::memory_order_relaxed);
+        if ((uint16_t)(head - _tail.load(std::memory_order_acquire)) == Capacity)
+        {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _items[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Copy up to count items from the front without taking them, consumer side only. Returns how many were copied
+    uint16_t peek(T *items, uint16_t count) const
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        uint16_t queued = _head.load(std::memory_order_acquire) - tail;
+        if (count > queued)
+        {
+            count = queued;
+        }
+        for (uint16_t i = 0; i < count; i++)
+        {
+            items[i] = _items[(uint16_t)(tail + i) & (Capacity - 1)];
+        }
+        return count;
+    }
+
+    // Take up to count items from the front without copying them, after a peek()
+    void discard(uint16_t count)
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        uint16_t queued = _head.load(std::memory_order_acquire) - tail;
+        _tail.store(tail + (count < queued ? count : queued), std::memory_order_release);
+    }
+
+    uint16_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    uint16_t capacity() const { return Capacity; }
+
+    // Number of pushes dropped since the last call
+    uint32_t takeDropped() { return _dropped.exchange(0, std::memory_order_relaxed); }
+
+private:
+    T _items[Capacity];
+    std::atomic<uint16_t> _head{0}; // Written by the producer only
+    std::atomic<uint16_t> _tail{0}; // Written by the consumer only
+    std::atomic<uint32_t> _dropped{0};
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,187 @@
+#include "Scheduler.h"
+
+int8_t Scheduler::add(Task task, uint32_t delay)
+{
+    for (uint8_t id = 0; id < SCHEDULER_MAX_TASKS; id++)
+    {
+        if (_slots[id].active || (int8_t)id == _running)
+        {
+            continue;
+        }
+        _slots[id].task = task;
+        _slots[id].active = true;
+        schedule(id, millis() + delay);
+        return id;
+    }
+    return -1;
+}
+
+void Scheduler::remove(int8_t id)
+{
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS || !_slots[id].active)
+    {
+        return;
+    }
+    _slots[id].active = false;
+    for (uint8_t i = 0; i < SCHEDULER_MAX_WATCHES; i++)
+    {
+        if (_watches[i].id == id)
+        {
+            _watches[i] = Watch();
+        }
+    }
+    if (id == _running)
+    {
+        return; // Still executing, runDue() frees the slot once the task returns
+    }
+    unlink(id);
+    _slots[id].task = nullptr;
+}
+
+void Scheduler::wake(int8_t id)
+{
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS || !_slots[id].active || id == _running)
+    {
+        return;
+    }
+    unlink(id);
+    schedule(id, millis());
+}
+
+bool Scheduler::watch(Stream &stream, int8_t id)
+{
+    Stream *source = &stream;
+    return watch([source]() { return source->available() > 0; }, id);
+}
+
+bool Scheduler::watch(Condition ready, int8_t id)
+{
+    if (!ready)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < SCHEDULER_MAX_WATCHES; i++)
+    {
+        if (!_watches[i].ready)
+        {
+            _watches[i].ready = ready;
+            _watches[i].id = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::handled(uint32_t eventMicros)
+{
+    uint32_t latency = micros() - eventMicros;
+    _stats.handled++;
+    _stats.lastLatency = latency;
+    _stats.totalLatency += latency;
+    if (latency > _stats.maxLatency)
+    {
+        _stats.maxLatency = latency;
+    }
+}
+
+void Scheduler::run()
+{
+    uint32_t wait = runDue();
+    if (wait == STOP)
+    {
+        return; // Nothing scheduled, leave loop() to the caller
+    }
+    uint32_t start = millis();
+    while (wait > 0 && (uint32_t)(millis() - start) < wait)
+    {
+        if (watchedReady())
+        {
+            _stats.wakes++;
+            break;
+        }
+        delay(SCHEDULER_SLEEP_STEP);
+    }
+    _stats.sleptMillis += millis() - start;
+}
+
+uint32_t Scheduler::runDue()
+{
+    watchedReady();
+    uint8_t budget = _count; // Each task at most once a pass, so one that always returns 0 cannot starve loop()
+    while (_count > 0 && budget-- > 0)
+    {
+        uint8_t id = _order[0];
+        uint32_t now = millis();
+        int32_t early = (int32_t)(_slots[id].deadline - now);
+        if (early > 0)
+        {
+            break;
+        }
+        if (early < 0)
+        {
+            _stats.late++;
+        }
+        unlink(id);
+        _running = id;
+        uint32_t next = _slots[id].task();
+        _running = -1;
+        _stats.runs++;
+        if (!_slots[id].active || next == STOP)
+        {
+            _slots[id].active = true; // Let remove() clear the watches and free the slot
+            remove(id);
+            continue;
+        }
+        schedule(id, millis() + next);
+    }
+    if (_count == 0)
+    {
+        return STOP;
+    }
+    int32_t wait = (int32_t)(_slots[_order[0]].deadline - millis());
+    return wait > 0 ? wait : 0;
+}
+
+void Scheduler::schedule(uint8_t id, uint32_t deadline)
+{
+    _slots[id].deadline = deadline;
+    uint8_t position = _count;
+    while (position > 0 && (int32_t)(_slots[_order[position - 1]].deadline - deadline) > 0)
+    {
+        _order[position] = _order[position - 1];
+        position--;
+    }
+    _order[position] = id;
+    _count++;
+}
+
+void Scheduler::unlink(uint8_t id)
+{
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_order[i] != id)
+        {
+            continue;
+        }
+        for (uint8_t j = i + 1; j < _count; j++)
+        {
+            _order[j - 1] = _order[j];
+        }
+        _count--;
+        return;
+    }
+}
+
+bool Scheduler::watchedReady()
+{
+    bool ready = false;
+    for (uint8_t i = 0; i < SCHEDULER_MAX_WATCHES; i++)
+    {
+        if (_watches[i].ready && _watches[i].ready())
+        {
+            wake(_watches[i].id);
+            ready = true;
+        }
+    }
+    return ready;
+}
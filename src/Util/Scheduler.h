@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <functional>
+#include "Arduino.h"
+
+#define SCHEDULER_MAX_TASKS 8 // Task slots, fixed so nothing is allocated after setup()
+#define SCHEDULER_MAX_WATCHES 4 // Wake sources that can run a task early
+#define SCHEDULER_SLEEP_STEP 1 // Milliseconds per delay() while idle, the most a wake source waits to be noticed
+
+/*
+ * Cooperative scheduler for loop().
+ * Tasks sit in fixed slots and run once their deadline comes round, earliest first. A task returns how many
+ * milliseconds until it wants to run again, or Scheduler::STOP to free its slot. Between deadlines run() sleeps in
+ * delay(), which hands the time to the system thread, and wakes early when a watched source is ready: a stream with
+ * bytes waiting, or a condition such as an interrupt queue that is not empty. Only the tasks watching that source run.
+ * A task that handles timestamped events reports each one with handled(), so the latency stats start at the event
+ * rather than at the wake that noticed it. Times come from millis() and survive its wrap.
+ */
+class Scheduler
+{
+public:
+    typedef std::function<uint32_t()> Task;
+    typedef std::function<bool()> Condition; // Polled while sleeping, keep it to a flag or an index compare
+    static const uint32_t STOP = 0xFFFFFFFF;
+
+    struct Stats
+    {
+        uint32_t runs = 0; // Task calls
+        uint32_t late = 0; // Calls that started 1 ms or more after their deadline
+        uint32_t wakes = 0; // Sleeps cut short by a ready wake source
+        uint32_t sleptMillis = 0;
+        uint32_t handled = 0; // Events the tasks reported through handled()
+        uint32_t lastLatency = 0; // Microseconds from an event's timestamp to its handled() call
+        uint32_t maxLatency = 0;
+        uint32_t totalLatency = 0; // Over every handled event, for the average
+    };
+
+    int8_t add(Task task, uint32_t delay = 0); // Slot id, -1 when every slot is taken
+    void remove(int8_t id);
+    void wake(int8_t id); // Run on the next pass instead of at its deadline
+    bool watch(Stream &stream, int8_t id); // wake() id whenever stream has bytes available
+    bool watch(Condition ready, int8_t id); // wake() id whenever ready() returns true
+    void handled(uint32_t eventMicros); // A task has dealt with an event stamped with micros() where it happened, such as in an ISR
+    void run(); // Run every task that is due, then sleep until the next deadline or stream activity
+    uint32_t runDue(); // Run every task that is due without sleeping, returns milliseconds until the next deadline or STOP when there are no tasks
+    uint8_t count() const { return _count; }
+    const Stats &stats() const { return _stats; }
+
+private:
+    struct Slot
+    {
+        Task task;
+        uint32_t deadline = 0;
+        bool active = false;
+    };
+    struct Watch
+    {
+        Condition ready;
+        int8_t id = -1;
+    };
+
+    Slot _slots[SCHEDULER_MAX_TASKS];
+    uint8_t _order[SCHEDULER_MAX_TASKS]; // Active slot ids, earliest deadline first
+    uint8_t _count = 0;
+    Watch _watches[SCHEDULER_MAX_WATCHES];
+    int8_t _running = -1; // Slot whose task is being called, so it can remove itself
+    Stats _stats;
+
+    void schedule(uint8_t id, uint32_t deadline); // (Re)insert id into _order at its deadline
+    void unlink(uint8_t id); // Take id out of _order
+    bool watchedReady(); // Wake the tasks of every ready source, true if there were any
+};
+
+#endif // SCHEDULER_H
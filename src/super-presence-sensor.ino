@@ -1,6 +1,9 @@
 
 #include "Radar/Radar.h"
-MR24HPB1 radar(Serial1,18,19);
+#include "Util/Scheduler.h"
+#include "Util/RingBuffer.h"
+MR24HPB1::MR24HPB1 radar(Serial1,18,19);
+Scheduler scheduler;
 // // some example callbacks
 // void unocc(){Serial.println("UNOCCUPIED");}
 // void occ(){Serial.println("OCCUPIED");}
@@ -58,14 +61,138 @@ MR24HPB1 radar(Serial1,18,19);
 
 #include "Arduino.h"
 
+#define RADAR_POLL_INTERVAL 20 // ms between refresh() calls while Serial1 and S1/S2 are quiet, activity wakes it sooner
+#define PIN_SAMPLE_INTERVAL 250 // ms between drains of the pin event queue while no edge wakes it, for the drop report
+#define PUBLISH_INTERVAL 1000 // the cloud accepts about one event a second, the least time between two publishes
+#define PUBLISH_RECHECK_INTERVAL 60000 // the presence watch runs publishPresence(), this only bounds a missed change
+#define CONFIG_POLL_INTERVAL 10
+#define PIN_EVENT_BUFFER_LENGTH 32 // edges the ISRs can queue between two drains, a power of two
+#define PIN_EVENT_TIMING 0 // 1 to measure the ISRs with the cycle counter
+
+// Driver polling, Serial1 bytes and S1/S2 edges wake it early
+uint32_t lastRadarEdge = 0;
+uint32_t serialReadyAt = 0; // micros() when the Serial1 watch first saw the bytes pollRadar() has not consumed yet
+bool serialStamped = false;
+bool serialReady() {
+  if (Serial1.available() <= 0)
+    return false;
+  if (!serialStamped) {
+    serialReadyAt = micros();
+    serialStamped = true;
+  }
+  return true;
+}
+uint32_t pollRadar() {
+  radar.refresh();
+  if (radar.getLastEdgeMicros() != lastRadarEdge) { // refresh() dispatched S1/S2 edges, time the latest from its ISR
+    lastRadarEdge = radar.getLastEdgeMicros();
+    scheduler.handled(lastRadarEdge);
+  }
+  if (serialStamped) {
+    if (radar.getUpdatedMemberType() != 0xFF) // a frame was decoded, time it from the watch that saw its bytes
+      scheduler.handled(serialReadyAt);
+    serialStamped = Serial1.available() > 0; // the rest of a frame keeps the stamp
+  }
+  return RADAR_POLL_INTERVAL;
+}
+
+// D9/D10 presence inputs, queued by the ISRs and drained here into the levels publishPresence() reports
+struct PinEvent {
+  uint8_t pin;
+  uint8_t level;
+  uint32_t timestamp; // micros() at the edge
+};
+RingBuffer<PinEvent, PIN_EVENT_BUFFER_LENGTH> pinEvents;
+bool levelD9 = false, levelD10 = false;
+uint32_t pinEventsDropped = 0;
+#if PIN_EVENT_TIMING
+volatile uint32_t isrMaxTicks = 0;
+uint32_t reportedIsrTicks = 0;
+#endif
+
+uint32_t drainPins() {
+  PinEvent event;
+  while (pinEvents.pop(event)) {
+    if (event.pin == D9)
+      levelD9 = event.level;
+    else
+      levelD10 = event.level;
+    scheduler.handled(event.timestamp);
+  }
+  uint32_t dropped = pinEvents.takeDropped();
+  if (dropped > 0) {
+    pinEventsDropped += dropped;
+    Serial.printlnf("%lu pin events dropped, %lu since boot", dropped, pinEventsDropped);
+  }
+#if PIN_EVENT_TIMING
+  if (isrMaxTicks != reportedIsrTicks) {
+    reportedIsrTicks = isrMaxTicks;
+    Serial.printlnf("pin ISR worst case %lu cycles", reportedIsrTicks);
+  }
+#endif
+  return PIN_SAMPLE_INTERVAL;
+}
+
+// Publishing, only when the presence state has changed. Any of the radar, D9 or D10 counts as occupied
+int8_t publishedPresence = -1;
+uint32_t publishedAt = 0;
+bool currentPresence() {
+  return radar.getPresence() || levelD9 || levelD10;
+}
+// Watched, so a change wakes publishPresence() as soon as the rate limit allows instead of at its next poll
+bool presenceChanged() {
+  if (currentPresence() == publishedPresence || !Particle.connected())
+    return false;
+  return publishedPresence < 0 || millis() - publishedAt >= PUBLISH_INTERVAL;
+}
+uint32_t publishPresence() {
+  uint32_t since = millis() - publishedAt;
+  if (publishedPresence >= 0 && since < PUBLISH_INTERVAL)
+    return PUBLISH_INTERVAL - since; // the cloud has not had a second since the last event
+  bool presence = currentPresence();
+  if (presence != publishedPresence && Particle.connected()) {
+    Particle.publish("presence", presence ? "occupied" : "unoccupied", PRIVATE);
+    publishedPresence = presence;
+    publishedAt = millis();
+  }
+  return PUBLISH_RECHECK_INTERVAL;
+}
+
+// Config state machine, runs once after boot and then frees its slot
+enum ConfigState { CONFIG_START, CONFIG_WAIT };
+ConfigState configState = CONFIG_START;
+uint32_t configureRadar() {
+  switch (configState) {
+    case CONFIG_START:
+      radar.startup(); // queries go out together, pollRadar() collects the answers
+      configState = CONFIG_WAIT;
+      return CONFIG_POLL_INTERVAL;
+    case CONFIG_WAIT:
+      if (!radar.startupComplete())
+        return CONFIG_POLL_INTERVAL;
+      Serial.printlnf("radar startup: confirmed 0x%02x, first state after %lu ms", radar.getStartupConfirmed(), radar.getStartupTime());
+      return Scheduler::STOP;
+  }
+  return Scheduler::STOP;
+}
+
 void setup() {
   // put your setup code here, to run once:
   Serial.begin(250000);
   pinMode(D9, INPUT);
   pinMode(D10, INPUT);
+  levelD9 = pinReadFast(D9);
+  levelD10 = pinReadFast(D10);
   attachInterrupt(digitalPinToInterrupt(D9), interruptD9, CHANGE);
   attachInterrupt(digitalPinToInterrupt(D10), interruptD10, CHANGE);
-  // radar.begin(2,(scene_setting_t) 3);
+  radar.attachPinInterrupts(); // S1/S2 edges are queued between polls instead of missed
+  // each wake source only runs the task that handles it
+  int8_t radarTask = scheduler.add(pollRadar);
+  scheduler.watch(serialReady, radarTask);
+  scheduler.watch([]() { return radar.pinEdgesPending(); }, radarTask);
+  scheduler.watch([]() { return !pinEvents.empty(); }, scheduler.add(drainPins));
+  scheduler.watch(presenceChanged, scheduler.add(publishPresence));
+  scheduler.add(configureRadar);
   // radar.register_on_unoccupied(unocc);
   // radar.register_on_occupied(occ);
   // radar.register_on_stationary(stat);
@@ -75,22 +202,27 @@ void setup() {
   // radar.register_on_motor_signs(mot);
 }
 
+// Interrupt context, so no printing or waiting: queue the edge and return
+void queuePinEvent(uint8_t pin) {
+#if PIN_EVENT_TIMING
+  uint32_t start = System.ticks();
+#endif
+  pinEvents.push(PinEvent{pin, (uint8_t)pinReadFast(pin), micros()}); // a full buffer counts the drop
+#if PIN_EVENT_TIMING
+  uint32_t ticks = System.ticks() - start;
+  if (ticks > isrMaxTicks)
+    isrMaxTicks = ticks;
+#endif
+}
 void interruptD9() {
-  Serial.println('D9 INTERRUPT');
+  queuePinEvent(D9);
 }
 void interruptD10() {
-  Serial.println('D10 INTERRUPT');
+  queuePinEvent(D10);
 }
 
 void loop() {
-  // put your main code here, to run repeatedly:
+  // every task above runs from here, between deadlines the scheduler sleeps until one is due or a wake source is ready
   // parseserial();
-  // radar.refresh();
-  // long now = millis();
-  // if(radar.getUpdatedMemberType() == 0x0C){
-  //      Serial.println("Got a new Threshold!");
-  //      delay(5000);
-  // }
-  
-  delay(1000);
+  scheduler.run();
 }
\ No newline at end of file
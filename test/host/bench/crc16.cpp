@@ -0,0 +1,53 @@
+/*
+ * CRC16 throughput of the generated implementation against the hand written tables it replaced.
+ * Built once per MR24HPB1_CRC16_IMPLEMENTATION, since the table is chosen at compile time.
+ *   bench_crc16 [frames]
+ */
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+#include "Radar/MR24HPB1/MR24HPB1_protocol.h"
+#include "MR24HPB1_crc16_reference.h"
+
+#define BENCH_RUNS 7
+
+template <typename Crc>
+double best(const std::vector<uint8_t> &bytes, uint8_t length, Crc crc)
+{
+    volatile uint16_t sink = 0;
+    double bestNanos = 0;
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint16_t total = 0;
+        for (size_t offset = 0; offset + length <= bytes.size(); offset += length)
+            total ^= crc(&bytes[offset], length);
+        sink = total;
+        double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || nanos < bestNanos)
+            bestNanos = nanos;
+    }
+    (void)sink;
+    return bestNanos;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    const char *name = MR24HPB1_CRC16_IMPLEMENTATION == MR24HPB1_CRC16_NIBBLE ? "nibble" : "table";
+    for (uint8_t length : {9, 28})
+    {
+        std::vector<uint8_t> bytes(frames * length);
+        uint32_t random = 1;
+        for (uint8_t &byte : bytes)
+        {
+            random = random * 1103515245 + 12345;
+            byte = random >> 16;
+        }
+        double reference = best(bytes, length, [](const uint8_t *frame, uint8_t size) { return Reference::getCRC16(frame, size); });
+        double generated = best(bytes, length, [](const uint8_t *frame, uint8_t size) { return MR24HPB1::CRC16::compute(frame, size); });
+        printf("%2u byte frames: reference %6.2f ns/frame, %-6s %6.2f ns/frame (%u bytes of table)\n", length, reference / frames, name, generated / frames,
+               (unsigned)sizeof(MR24HPB1::CRC16::table));
+    }
+    return 0;
+}
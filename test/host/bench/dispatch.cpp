@@ -0,0 +1,108 @@
+/*
+ * Report dispatch through the shared route table against the switch trees it replaced, over a mix of every report
+ * both drivers decode. Frames are already assembled, so only the decode and the callbacks are timed.
+ *   bench_dispatch [rounds]
+ */
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+#include "Radar/MR24HPB1/MR24HPB1.h"
+#include "MR24HPB1_switch_reference.h"
+
+#define BENCH_RUNS 7
+
+using namespace MR24HPB1;
+
+namespace
+{
+    struct Frame
+    {
+        uint8_t bytes[MR24HPB1_MAX_FRAME_LENGTH];
+        FrameView view;
+    };
+
+    std::vector<Frame> frameMix()
+    {
+        struct Report
+        {
+            uint8_t function, address1, address2;
+            uint8_t data[4];
+            uint8_t length;
+        };
+        const Report reports[] = {
+            {PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, {0x00, 0xFF, 0xFF}, 3},
+            {PROACTIVE_REPORT, RADAR_INFO, MOTOR_SIGNS, {0x00, 0x00, 0x80, 0x3F}, 4},
+            {PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, {0x01, 0x00, 0xFF}, 3},
+            {PROACTIVE_REPORT, RADAR_INFO, APPROACHING_AWAY_STATE, {0x01, 0x01, 0x02}, 3},
+            {PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, {0x01, 0x01, 0x01}, 3},
+            {PROACTIVE_REPORT, OTHER, HEARTBEAT, {0x01, 0x01, 0x01}, 3},
+            {PASSIVE_REPORT, SYSTEM_PARAM, THRESHOLD_GEAR, {0x07}, 1},
+            {PASSIVE_REPORT, SYSTEM_PARAM, SCENE_SETTING, {0x04}, 1},
+        };
+        std::vector<Frame> frames(sizeof(reports) / sizeof(reports[0]));
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            const Report &report = reports[i];
+            uint8_t length = buildFrame(frames[i].bytes, report.function, report.address1, report.address2, report.data, report.length);
+            frames[i].view = FrameView{frames[i].bytes, length};
+        }
+        return frames;
+    }
+
+    template <typename Decode>
+    double best(const std::vector<Frame> &frames, uint32_t rounds, Decode decode)
+    {
+        double bestNanos = 0;
+        for (int run = 0; run < BENCH_RUNS; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t round = 0; round < rounds; round++)
+            {
+                for (const Frame &frame : frames)
+                {
+                    decode(frame.view);
+                }
+            }
+            double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (run == 0 || nanos < bestNanos)
+            {
+                bestNanos = nanos;
+            }
+        }
+        return bestNanos / (rounds * frames.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    std::vector<Frame> frames = frameMix();
+    uint32_t callbacks = 0;
+
+    Reference::LegacyDecoder legacy;
+    legacy._on_environmental_state = [&](uint8_t) { callbacks++; };
+    legacy._on_away_state = [&](uint8_t) { callbacks++; };
+    legacy._on_motor_signs = [&](float) { callbacks++; };
+    HardwareSerial uart;
+    ::MR24HPB1::MR24HPB1 sensor(uart, 18, 19);
+    sensor.register_on_environmental_state([&](uint8_t) { callbacks++; });
+    sensor.register_on_away_state([&](uint8_t) { callbacks++; });
+    sensor.register_on_motor_signs([&](float) { callbacks++; });
+    double legacyNanos = best(frames, rounds, [&](const FrameView &frame) { legacy.parseMsg(frame); });
+    double sensorNanos = best(frames, rounds, [&](const FrameView &frame) { Dispatch<::MR24HPB1::MR24HPB1>::dispatch(sensor, frame); });
+    printf("MR24HPB1 parseMsg  switch %6.1f ns/frame, route table %6.1f ns/frame\n", legacyNanos, sensorNanos);
+
+    Reference::RadarDecoder radarSwitch;
+    radarSwitch._occupancyCallback = [&](Occupancy::State) { callbacks++; };
+    radarSwitch._motionCallback = [&](Motion::State) { callbacks++; };
+    radarSwitch._directionCallback = [&](Direction::State) { callbacks++; };
+    Radar radar(uart);
+    radar.registerOccupancyCallback([&](Occupancy::State) { callbacks++; });
+    radar.registerMotionCallback([&](Motion::State) { callbacks++; });
+    radar.registerDirectionCallback([&](Direction::State) { callbacks++; });
+    double radarSwitchNanos = best(frames, rounds, [&](const FrameView &frame) { radarSwitch.process(frame); });
+    double radarNanos = best(frames, rounds, [&](const FrameView &frame) { Dispatch<RadarCore>::dispatch(radar, frame); });
+    printf("Radar::process     switch %6.1f ns/frame, route table %6.1f ns/frame\n", radarSwitchNanos, radarNanos);
+    printf("%lu callbacks\n", (unsigned long)callbacks);
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Parser microbenchmarks, the baseline for every performance change to src/Radar.
+ * Each case decodes the same in-memory capture repeatedly through the in-memory UART and reports the best run.
+ *   bench_parsers [frames]
+ */
+#include <chrono>
+#include <stdlib.h>
+#include <vector>
+#include "Arduino.h"
+#include "Radar/LD2410/LD2410.h"
+#include "Radar/MR24HPB1/MR24HPB1.h"
+#include "Radar/MR24HPB1/MR24HPB1_protocol.h"
+#include "LD2410Simulator.h"
+
+#define BENCH_RUNS 7
+
+namespace
+{
+    struct Result
+    {
+        double nanos = 0; // Best run
+        uint32_t decoded = 0; // Frames or callbacks in that run, the same every run
+    };
+
+    template <typename Run>
+    Result best(Run run)
+    {
+        Result result;
+        for (int i = 0; i < BENCH_RUNS; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint32_t frames = run();
+            double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || nanos < result.nanos)
+            {
+                result.nanos = nanos;
+                result.decoded = frames;
+            }
+        }
+        return result;
+    }
+
+    void report(const char *name, const Result &result, uint32_t frames, size_t bytes)
+    {
+        printf("%-36s %9.1f ns/frame %9.1f MB/s %8u decoded\n", name, result.nanos / frames, bytes * 1000.0 / result.nanos, result.decoded);
+    }
+
+    std::vector<uint8_t> drain(Stream &stream)
+    {
+        std::vector<uint8_t> bytes;
+        while (stream.available() > 0)
+        {
+            bytes.push_back(stream.read());
+        }
+        return bytes;
+    }
+
+    std::vector<uint8_t> ld2410Frames(uint32_t frames, bool engineering)
+    {
+        LD2410Simulator simulator;
+        simulator.setReportRate(0);
+        simulator.setEngineeringMode(engineering);
+        simulator.setTarget(3, 120, 60, 180, 40, 150);
+        std::vector<uint8_t> bytes;
+        while (frames > 0)
+        {
+            uint16_t queued = simulator.burst(frames < 8 ? frames : 8);
+            frames -= queued;
+            std::vector<uint8_t> chunk = drain(simulator);
+            bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+        }
+        return bytes;
+    }
+
+    std::vector<uint8_t> mr24hpb1Frames(uint32_t frames)
+    {
+        // Environment reports cycling through the three states, so every frame changes the decoded value
+        static const uint8_t states[3][3] = {{0x00, 0xFF, 0xFF}, {0x01, 0x00, 0xFF}, {0x01, 0x01, 0x01}};
+        std::vector<uint8_t> bytes;
+        uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            uint8_t length = MR24HPB1::buildFrame(frame, MR24HPB1::Command::ACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, states[i % 3], 3);
+            bytes.insert(bytes.end(), frame, frame + length);
+        }
+        return bytes;
+    }
+
+    void benchLD2410(const char *name, uint32_t frames, bool engineering)
+    {
+        std::vector<uint8_t> bytes = ld2410Frames(frames, engineering);
+        HardwareSerial uart;
+        uart.inject(bytes);
+        LD2410 radar(uart);
+        report(name, best([&]() {
+            uart.rewind();
+            uint32_t decoded = 0;
+            while (uart.available() > 0)
+            {
+                decoded += radar.read();
+            }
+            return decoded;
+        }), frames, bytes.size());
+    }
+
+    void benchCRC16(uint32_t frames)
+    {
+        std::vector<uint8_t> bytes = mr24hpb1Frames(frames);
+        const uint8_t frameLength = 11; // Environment report
+        volatile uint16_t sink = 0;
+        report("MR24HPB1::CRC16::compute (9 bytes)", best([&]() {
+            uint16_t crc = 0;
+            for (size_t offset = 0; offset + frameLength <= bytes.size(); offset += frameLength)
+            {
+                crc ^= MR24HPB1::CRC16::compute(&bytes[offset], frameLength - 2);
+            }
+            sink = crc;
+            return frames;
+        }), frames, bytes.size());
+        (void)sink;
+    }
+
+    void benchRefresh(uint32_t frames)
+    {
+        std::vector<uint8_t> bytes = mr24hpb1Frames(frames);
+        HardwareSerial uart;
+        uart.inject(bytes);
+        MR24HPB1::MR24HPB1 sensor(uart, 18, 19);
+        uint32_t changes = 0;
+        sensor.register_on_environmental_state([&](uint8_t) { changes++; });
+        report("MR24HPB1::refresh (parseMsg)", best([&]() {
+            uart.rewind();
+            changes = 0;
+            while (uart.available() > 0)
+            {
+                sensor.refresh();
+            }
+            sensor.refresh(); // The last frame completes on the final byte
+            return changes;
+        }), frames, bytes.size());
+    }
+
+    void benchRadarLoop(uint32_t frames)
+    {
+        std::vector<uint8_t> bytes = mr24hpb1Frames(frames);
+        HardwareSerial uart;
+        uart.inject(bytes);
+        MR24HPB1::Radar radar(uart);
+        uint32_t changes = 0;
+        radar.registerMotionCallback([&](MR24HPB1::Motion::State) { changes++; }); // Changes on two frames in three
+        radar.setFrameBudget(255);
+        report("MR24HPB1::Radar::loop", best([&]() {
+            uart.rewind();
+            changes = 0;
+            while (uart.available() > 0)
+            {
+                radar.loop();
+            }
+            radar.loop();
+            return changes;
+        }), frames, bytes.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    benchLD2410("LD2410::read_frame_ normal", frames, false);
+    benchLD2410("LD2410::read_frame_ engineering", frames, true);
+    benchCRC16(frames);
+    benchRefresh(frames);
+    benchRadarLoop(frames);
+    return 0;
+}
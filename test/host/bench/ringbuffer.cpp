@@ -0,0 +1,79 @@
+/*
+ * The D9/D10 interrupt handlers' body, a RingBuffer::push() of the pin level and micros(), into a buffer with room
+ * and into a full one. The pin and clock reads are the shim's, a load each.
+ * The buffer is drained between batches outside the timed region, so only the pushes are counted.
+ *   bench_ringbuffer [pushes]
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Arduino.h"
+#include "Util/RingBuffer.h"
+
+#define BENCH_RUNS 7
+#define PIN_EVENT_BUFFER_LENGTH 32 // As in the firmware
+
+namespace
+{
+    // Same layout as the firmware's PinEvent
+    struct PinEvent
+    {
+        uint8_t pin;
+        uint8_t level;
+        uint32_t timestamp;
+    };
+
+    RingBuffer<PinEvent, PIN_EVENT_BUFFER_LENGTH> events;
+
+    // Kept out of line, an interrupt handler is always a call
+    __attribute__((noinline)) void queue(uint8_t pin)
+    {
+        events.push(PinEvent{pin, (uint8_t)digitalRead(pin), micros()});
+    }
+
+    void drain()
+    {
+        events.discard(events.size());
+        events.takeDropped();
+    }
+
+    // Best of BENCH_RUNS, ns per push. A full buffer is filled once and every push is dropped
+    double best(uint32_t pushes, bool full)
+    {
+        double bestNanos = 0;
+        for (int run = 0; run < BENCH_RUNS; run++)
+        {
+            double nanos = 0;
+            for (uint32_t done = 0; done < pushes; done += PIN_EVENT_BUFFER_LENGTH)
+            {
+                drain();
+                if (full)
+                {
+                    for (uint16_t i = 0; i < PIN_EVENT_BUFFER_LENGTH; i++)
+                        queue(9);
+                }
+                auto start = std::chrono::steady_clock::now();
+                for (uint16_t i = 0; i < PIN_EVENT_BUFFER_LENGTH; i++)
+                    queue(i & 1 ? 9 : 10);
+                nanos += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (run == 0 || nanos < bestNanos)
+                bestNanos = nanos;
+        }
+        uint32_t batches = (pushes + PIN_EVENT_BUFFER_LENGTH - 1) / PIN_EVENT_BUFFER_LENGTH;
+        return bestNanos / (batches * PIN_EVENT_BUFFER_LENGTH);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t pushes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000000;
+    double room = best(pushes, false);
+    double full = best(pushes, true);
+    drain();
+    queue(9);
+    if (events.size() != 1)
+        return 1;
+    printf("push %6.1f ns, push onto a full buffer %6.1f ns (%u entries)\n", room, full, PIN_EVENT_BUFFER_LENGTH);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Radar::loop() over a Stream, a virtual call per byte, against BasicRadar over a final transport with the same
+ * in-memory UART, whose read() is inlined into the receive loop. Both drivers are built here at -Os as the firmware is.
+ *   bench_transport [rounds]
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "Radar/MR24HPB1/MR24HPB1.h"
+
+#define BENCH_RUNS 7
+#define BENCH_FRAMES 64 // Environment reports per round, stationary and exercising in turn
+
+using namespace MR24HPB1;
+
+namespace
+{
+    // The shim's UART with nothing left to override, so a BasicRadar over it calls read() directly
+    class MemoryTransport final : public HardwareSerial
+    {
+    };
+
+    std::vector<uint8_t> environmentFrames()
+    {
+        std::vector<uint8_t> bytes;
+        uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+        for (uint16_t i = 0; i < BENCH_FRAMES; i++)
+        {
+            const uint8_t data[] = {0x01, (uint8_t)(i & 1), (uint8_t)(i & 1 ? 0x01 : 0xFF)};
+            uint8_t length = buildFrame(frame, PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, data, sizeof(data));
+            bytes.insert(bytes.end(), frame, frame + length);
+        }
+        return bytes;
+    }
+
+    // Best of BENCH_RUNS, ns for every round. uart holds the frames, rewound before each one
+    template <class Driver>
+    double best(Driver &radar, HardwareSerial &uart, uint32_t rounds)
+    {
+        double bestNanos = 0;
+        for (int run = 0; run < BENCH_RUNS; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t round = 0; round < rounds; round++)
+            {
+                uart.rewind();
+                radar.loop();
+            }
+            double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (run == 0 || nanos < bestNanos)
+                bestNanos = nanos;
+        }
+        return bestNanos;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    std::vector<uint8_t> bytes = environmentFrames();
+    uint32_t motions = 0;
+
+    HardwareSerial uart;
+    uart.inject(bytes);
+    Radar radar(uart);
+    radar.registerMotionCallback([&](Motion::State) { motions++; });
+    radar.setFrameBudget(255);
+    double stream = best(radar, uart, rounds);
+
+    MemoryTransport transport;
+    transport.inject(bytes);
+    BasicRadar<MemoryTransport> inlined(transport);
+    inlined.registerMotionCallback([&](Motion::State) { motions++; });
+    inlined.setFrameBudget(255);
+    double concrete = best(inlined, transport, rounds);
+
+    double total = (double)rounds * bytes.size();
+    printf("Radar::loop() over Stream& %5.2f ns/byte, BasicRadar<MemoryTransport> %5.2f ns/byte (%lu motion callbacks)\n",
+           stream / total, concrete / total, (unsigned long)motions);
+    return motions == 2ULL * BENCH_RUNS * rounds * BENCH_FRAMES ? 0 : 1; // Every frame moves the motion state
+}
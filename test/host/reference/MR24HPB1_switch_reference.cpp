@@ -0,0 +1,222 @@
+#include "MR24HPB1_switch_reference.h"
+
+namespace Reference
+{
+    using namespace MR24HPB1;
+
+    void LegacyDecoder::parseMsg(const FrameView &frame)
+    {
+        const uint8_t *msg = frame.frame + 1; // The driver's buffer started after the header
+        uint8_t msg_size = frame.length - 1;
+        addr_cmd1_t ADDRESS1 = (addr_cmd1_t)msg[3];
+        addr_cmd2_t ADDRESS2 = (addr_cmd2_t)msg[4];
+        switch (ADDRESS1)
+        { // function Codes
+        case MODULE_INFO:
+        {
+            // Not implemented (yet)
+            break;
+        }
+        case RADAR_INFO:
+        {
+            switch (ADDRESS2)
+            {
+            case ENVIRONMENTAL_STATUS:
+            {
+                updated_member = ENVIRONMENTAL_STATUS;
+                std::function<void(uint8_t)> _cb = _on_environmental_state;
+                auto prev = environmental_state;
+                auto new_ = prev;
+                if (msg[5] == 0x00 && msg[6] == 0xFF && msg[7] == 0xFF)
+                {
+                    new_ = (uint8_t)UNOCCUPIED;
+                    presence = false;
+                    motion = false;
+                }
+                else if (msg[5] == 0x01 && msg[6] == 0x00 && msg[7] == 0xFF)
+                {
+                    new_ = (uint8_t)STATIONARY;
+                    presence = true;
+                    motion = false;
+                }
+                else if (msg[5] == 0x01 && msg[6] == 0x01 && msg[7] == 0x01)
+                {
+                    new_ = (uint8_t)EXERCISING;
+                    presence = true;
+                    motion = true;
+                }
+                else
+                    _cb = NULL;
+
+                if (new_ != prev)
+                {
+                    environmental_state = new_;
+                    if (_cb != NULL)
+                        _cb((uint8_t)environmental_state);
+                }
+                break;
+            }
+            case MOTOR_SIGNS:
+            {
+                updated_member = MOTOR_SIGNS;
+                std::function<void(float)> _cb = _on_motor_signs;
+                FB signs;
+                signs.B[0] = msg[5];
+                signs.B[1] = msg[6];
+                signs.B[2] = msg[7];
+                signs.B[3] = msg[8];
+                if (signs.F >= motor_signs + 1 || signs.F <= motor_signs - 1)
+                {
+                    motor_signs = signs.F;
+                    if (_cb != NULL)
+                        _cb(signs.F);
+                }
+                break;
+            }
+            case APPROACHING_AWAY_STATE:
+            {
+                std::function<void(uint8_t)> _cb = _on_away_state;
+                updated_member = APPROACHING_AWAY_STATE;
+                if (msg[5] == 0x01 && msg[6] == 0x01)
+                {
+                    switch (msg[7])
+                    {
+                    case 0x01:
+                        away_state = (uint8_t)NONE;
+                        break;
+                    case 0x02:
+                        away_state = (uint8_t)CLOSE_TO;
+                        break;
+                    case 0x03:
+                        away_state = (uint8_t)STAY_AWAY;
+                        break;
+                    default:
+                        _cb = NULL;
+                    }
+                    if (_cb != NULL)
+                        _cb(away_state);
+                }
+                break;
+            }
+            }
+            break;
+        }
+        case SYSTEM_PARAM:
+        {
+            switch (ADDRESS2)
+            {
+            case THRESHOLD_GEAR:
+            {
+                updated_member = THRESHOLD_GEAR;
+                threshold = (msg[5] <= 10) ? msg[5] : threshold;
+                break;
+            }
+            case SCENE_SETTING:
+            {
+                scene_setting = (msg[5] > 0 && msg[5] <= 6) ? msg[5] : scene_setting;
+                break;
+            }
+            }
+            break;
+        }
+        case OTHER:
+        {
+            switch (ADDRESS2)
+            {
+            case HEARTBEAT:
+            {
+                updated_member = ENVIRONMENTAL_STATUS;
+                std::function<void(uint8_t)> _cb = _on_environmental_state;
+                if (msg[5] == 0x00 && msg[6] == 0xFF && msg[7] == 0xFF)
+                    environmental_state = (uint8_t)UNOCCUPIED;
+                else if (msg[5] == 0x01 && msg[6] == 0x00 && msg[7] == 0xFF)
+                    environmental_state = (uint8_t)STATIONARY;
+                else if (msg[5] == 0x01 && msg[6] == 0x01 && msg[7] == 0x01)
+                    environmental_state = (uint8_t)EXERCISING;
+                else
+                    _cb = NULL;
+                if (_cb != NULL)
+                    _cb((uint8_t)environmental_state);
+                break;
+            }
+            case ABNORMAL_RESET:
+            {
+                if (msg[5] == 0x0F)
+                    abnormalResets++;
+                break;
+            }
+            }
+            break;
+        }
+        default:
+            for (int i = 0; i < msg_size; i++)
+            {
+                Serial.print(" 0x");
+                Serial.print(msg[i], HEX);
+            }
+            Serial.println();
+            break;
+        }
+    }
+
+    void RadarDecoder::process(const FrameView &frame)
+    {
+        uint16_t commandAddress = (frame.address1() << 8) | frame.address2();
+        const uint8_t *data = frame.data();
+        switch (frame.function())
+        {
+        case Command::READ:
+            break;
+        case Command::WRITE:
+            break;
+        case Command::PASSIVE_REPORT:
+            switch (commandAddress)
+            {
+            case 0x040C: // Threshold
+                _threshold = data[0];
+                break;
+            case 0x0410: // Scene
+                _activeScene = static_cast<Scene::Name>(data[0]);
+                break;
+            case 0x0412: // Forced unoccupied
+                break;
+            }
+            break;
+        case Command::ACTIVE_REPORT:
+            switch (commandAddress)
+            {
+            case 0x0305: // Environment Status
+                setOccupancy(static_cast<Occupancy::State>(data[0]));
+                setMotion(static_cast<Motion::State>(data[1]));
+                break;
+            case 0x0306: // Body Parameters
+                break;
+            case 0x0307: // Direction
+                setDirection(static_cast<Direction::State>(data[2]));
+                break;
+            }
+            break;
+        }
+    }
+
+    void RadarDecoder::setOccupancy(Occupancy::State occupancy)
+    {
+        if (_occupancyCallback != NULL && occupancy != _occupancyState)
+            _occupancyCallback(occupancy);
+        _occupancyState = occupancy;
+    }
+
+    void RadarDecoder::setMotion(Motion::State motion)
+    {
+        if (_motionCallback != NULL && motion != _motionState)
+            _motionCallback(motion);
+        _motionState = motion;
+    }
+
+    void RadarDecoder::setDirection(Direction::State direction)
+    {
+        if (_directionCallback != NULL && direction != _directionState)
+            _directionCallback(direction);
+        _directionState = direction;
+    }
+};
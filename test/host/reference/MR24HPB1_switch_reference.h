@@ -0,0 +1,51 @@
+#ifndef MR24HPB1_SWITCH_REFERENCE_H
+#define MR24HPB1_SWITCH_REFERENCE_H
+
+#include <functional>
+#include "Radar/MR24HPB1/MR24HPB1.h"
+
+/*
+ * The nested switch decoders MR24HPB1::parseMsg() and Radar::process() used before reports were dispatched through
+ * the shared route table, kept as the reference the table is benchmarked and sized against. They take the frame
+ * as a FrameView, the logic and the state they update are as the drivers had them.
+ */
+namespace Reference
+{
+    class LegacyDecoder
+    {
+    public:
+        void parseMsg(const MR24HPB1::FrameView &frame);
+
+        std::function<void(uint8_t)> _on_away_state;
+        std::function<void(uint8_t)> _on_environmental_state;
+        std::function<void(float)> _on_motor_signs;
+        int8_t away_state = -1, threshold = -1, scene_setting = -1, environmental_state = -1;
+        uint8_t abnormalResets = 0;
+        uint8_t updated_member = 0xFF;
+        float motor_signs = 0;
+        bool presence = false, motion = false;
+    };
+
+    class RadarDecoder
+    {
+    public:
+        void process(const MR24HPB1::FrameView &frame);
+
+        MR24HPB1::OccupancyCallback _occupancyCallback;
+        MR24HPB1::MotionCallback _motionCallback;
+        MR24HPB1::DirectionCallback _directionCallback;
+
+    private:
+        MR24HPB1::Scene::Name _activeScene = MR24HPB1::Scene::UNKNOWN;
+        uint8_t _threshold = 7;
+        MR24HPB1::Occupancy::State _occupancyState = MR24HPB1::Occupancy::UNKNOWN;
+        MR24HPB1::Motion::State _motionState = MR24HPB1::Motion::UNKNOWN;
+        MR24HPB1::Direction::State _directionState = MR24HPB1::Direction::UNKNOWN;
+
+        void setOccupancy(MR24HPB1::Occupancy::State);
+        void setMotion(MR24HPB1::Motion::State);
+        void setDirection(MR24HPB1::Direction::State);
+    };
+};
+
+#endif // MR24HPB1_SWITCH_REFERENCE_H
@@ -0,0 +1,121 @@
+#include "Arduino.h"
+#include <algorithm>
+
+#define HOST_PINS 64
+
+namespace
+{
+    uint64_t now = 0; // Microseconds since Host::reset()
+    int levels[HOST_PINS];
+    std::function<void()> handlers[HOST_PINS];
+
+    struct PinChange
+    {
+        uint64_t at;
+        uint16_t pin;
+        int level;
+    };
+    std::vector<PinChange> changes; // Scheduled pin changes, earliest first
+
+    // Move the clock on, stopping at each scheduled pin change to run its handler
+    void advance(uint64_t us)
+    {
+        uint64_t until = now + us;
+        while (!changes.empty() && changes.front().at <= until)
+        {
+            PinChange change = changes.front();
+            changes.erase(changes.begin());
+            now = std::max(now, change.at);
+            Host::setPin(change.pin, change.level);
+        }
+        now = until;
+    }
+}
+
+HostConsole Serial;
+HardwareSerial Serial1;
+
+uint32_t millis()
+{
+    return now / 1000;
+}
+
+uint32_t micros()
+{
+    return now;
+}
+
+void delay(uint32_t ms)
+{
+    advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    advance(us);
+}
+
+void pinMode(uint16_t, int)
+{
+}
+
+int digitalRead(uint16_t pin)
+{
+    return pin < HOST_PINS ? levels[pin] : LOW;
+}
+
+bool attachInterrupt(uint16_t pin, std::function<void()> handler, int)
+{
+    if (pin >= HOST_PINS)
+    {
+        return false;
+    }
+    handlers[pin] = handler;
+    return true;
+}
+
+void detachInterrupt(uint16_t pin)
+{
+    if (pin < HOST_PINS)
+    {
+        handlers[pin] = nullptr;
+    }
+}
+
+namespace Host
+{
+    void reset()
+    {
+        now = 0;
+        changes.clear();
+        for (uint16_t pin = 0; pin < HOST_PINS; pin++)
+        {
+            levels[pin] = LOW;
+            handlers[pin] = nullptr;
+        }
+    }
+
+    void advanceMicros(uint32_t us)
+    {
+        advance(us);
+    }
+
+    void setPin(uint16_t pin, int level)
+    {
+        if (pin >= HOST_PINS || levels[pin] == level)
+        {
+            return;
+        }
+        levels[pin] = level;
+        if (handlers[pin])
+        {
+            handlers[pin]();
+        }
+    }
+
+    void schedulePin(uint16_t pin, int level, uint32_t atMicros)
+    {
+        changes.push_back(PinChange{atMicros, pin, level});
+        std::stable_sort(changes.begin(), changes.end(), [](const PinChange &a, const PinChange &b) { return a.at < b.at; });
+    }
+};
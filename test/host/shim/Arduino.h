@@ -0,0 +1,173 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+ * Just enough of the Particle/Arduino API to build src/Radar and src/Util on Linux. Time only moves when the code
+ * under test calls delay() or a test calls Host::advanceMicros(), so runs are repeatable. HardwareSerial is an
+ * in-memory UART: the test injects what the sensor sends and reads back what the driver wrote. Pin changes can be
+ * scheduled for a point in time, their interrupt handlers then run from inside delay() as a real ISR would.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <vector>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HEX 16
+#define DEC 10
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define RISING 2
+#define FALLING 3
+#define F(string) (string)
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint16_t pin, int mode);
+int digitalRead(uint16_t pin);
+inline uint16_t digitalPinToInterrupt(uint16_t pin) { return pin; }
+bool attachInterrupt(uint16_t pin, std::function<void()> handler, int mode);
+void detachInterrupt(uint16_t pin);
+inline void interrupts() {}
+inline void noInterrupts() {}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t written = 0;
+        while (size-- > 0 && write(*buffer++) == 1)
+        {
+            written++;
+        }
+        return written;
+    }
+    size_t write(const char *string) { return write((const uint8_t *)string, strlen(string)); }
+
+    size_t print(const char *string) { return write(string); }
+    size_t print(char value) { return write((uint8_t)value); }
+    size_t print(unsigned long value, int base = DEC) { return printNumber(base == HEX ? "%lX" : "%lu", value); }
+    size_t print(long value, int base = DEC) { return printNumber(base == HEX ? "%lX" : "%ld", value); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(double value, int digits = 2)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", digits, value);
+        return write(text);
+    }
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(T value, int format) { return print(value, format) + println(); }
+
+private:
+    template <typename T>
+    size_t printNumber(const char *format, T value)
+    {
+        char text[24];
+        snprintf(text, sizeof(text), format, value);
+        return write(text);
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+/*
+ * In-memory UART. inject() queues bytes for read(), rewind() plays everything injected so far again, which is how
+ * the benchmarks feed the same capture through a driver many times.
+ */
+class HardwareSerial : public Stream
+{
+public:
+    virtual void begin(unsigned long baud) { _baud = baud; }
+    virtual void end() {}
+    int available() override { return _received.size() - _position; }
+    int read() override { return _position < _received.size() ? _received[_position++] : -1; }
+    int peek() override { return _position < _received.size() ? _received[_position] : -1; }
+    void flush() override {}
+    size_t write(uint8_t byte) override
+    {
+        _written.push_back(byte);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        _written.insert(_written.end(), buffer, buffer + size);
+        _writeCalls++;
+        return size;
+    }
+    using Print::write;
+
+    void inject(const uint8_t *bytes, size_t length) { _received.insert(_received.end(), bytes, bytes + length); }
+    void inject(const std::vector<uint8_t> &bytes) { inject(bytes.data(), bytes.size()); }
+    void rewind() { _position = 0; }
+    void clear()
+    {
+        _received.clear();
+        _position = 0;
+        _written.clear();
+        _writeCalls = 0;
+    }
+    const std::vector<uint8_t> &written() const { return _written; }
+    size_t writeCalls() const { return _writeCalls; } // Buffered writes, each one burst on a real UART
+    unsigned long baud() const { return _baud; }
+
+private:
+    std::vector<uint8_t> _received;
+    size_t _position = 0;
+    std::vector<uint8_t> _written;
+    size_t _writeCalls = 0;
+    unsigned long _baud = 0;
+};
+
+// USB console, written to stdout
+class HostConsole : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override { fflush(stdout); }
+    size_t write(uint8_t byte) override { return fputc(byte, stdout) == EOF ? 0 : 1; }
+    using Print::write;
+};
+
+extern HostConsole Serial;
+extern HardwareSerial Serial1;
+
+// Controls the tests have over the simulated board
+namespace Host
+{
+    void reset(); // Time back to zero, pins low, interrupts detached
+    void advanceMicros(uint32_t us);
+    void setPin(uint16_t pin, int level); // Runs the pin's interrupt handler when the level changes
+    void schedulePin(uint16_t pin, int level, uint32_t atMicros); // setPin() once the clock passes atMicros, at that micros()
+};
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,485 @@
+/*
+ *	An emulated Hi-Link LD2410, see LD2410Simulator.h
+ */
+#include "LD2410Simulator.h"
+
+static const uint8_t LD2410_SIMULATOR_DEFAULT_MOTION_SENSITIVITY[LD2410_MAX_GATES] = { 50, 50, 40, 30, 20, 15, 15, 15, 15 };
+static const uint8_t LD2410_SIMULATOR_DEFAULT_STATIONARY_SENSITIVITY[LD2410_MAX_GATES] = { 0, 0, 40, 40, 30, 30, 20, 20, 20 };
+
+LD2410Simulator::LD2410Simulator(uint32_t seed) {
+	randomState = seed != 0 ? seed : 1;								//Xorshift never leaves zero
+	factoryReset();
+	lastRelease = micros();
+}
+
+int LD2410Simulator::available() {
+	service_();
+	return outputReleased;
+}
+
+int LD2410Simulator::read() {
+	service_();
+	if (outputReleased == 0)
+	{
+		return -1;
+	}
+	uint8_t byte = output[outputHead];
+	outputHead = (outputHead + 1) & (LD2410_SIMULATOR_BUFFER_LENGTH - 1);
+	outputCount--;
+	outputReleased--;
+	outputRead++;
+	while (unreadAckCount > 0 && (int32_t)(outputRead - unreadAcks[unreadAckHead].end) >= 0)
+	{
+		commandBytes -= unreadAcks[unreadAckHead].commandLength;
+		unreadAckHead = (unreadAckHead + 1) & (LD2410_SIMULATOR_MAX_UNREAD_ACKS - 1);
+		unreadAckCount--;
+	}
+	return byte;
+}
+
+int LD2410Simulator::peek() {
+	service_();
+	return outputReleased > 0 ? output[outputHead] : -1;
+}
+
+void LD2410Simulator::flush() {
+}
+
+size_t LD2410Simulator::write(uint8_t byte) {
+	if (receive_command_byte_(byte))
+	{
+		if (commandBytes + commandLength > LD2410_SIMULATOR_COMMAND_BUFFER || unreadAckCount == LD2410_SIMULATOR_MAX_UNREAD_ACKS)
+		{
+			statistics.commandsOverflowed++;
+		}
+		else
+		{
+			handle_command_();
+		}
+	}
+	return 1;
+}
+
+void LD2410Simulator::setReportRate(uint16_t framesPerSecond) {
+	reportInterval = framesPerSecond > 0 ? 1000000UL / framesPerSecond : 0;
+	reportScheduled = false;
+}
+
+void LD2410Simulator::setBaudRate(uint32_t baud) {
+	service_();														//Bytes already due are released at the old rate
+	baudRate = baud;
+	releaseCredit = 0;
+	lastRelease = micros();
+}
+
+void LD2410Simulator::setNoise(uint16_t perMille) {
+	noise = perMille;
+}
+
+void LD2410Simulator::setTruncation(uint16_t perMille) {
+	truncation = perMille;
+}
+
+void LD2410Simulator::setResponsive(bool isResponsive) {
+	responsive = isResponsive;
+}
+
+void LD2410Simulator::setEngineeringMode(bool enabled) {
+	engineeringMode = enabled;
+}
+
+void LD2410Simulator::setTarget(uint8_t type, uint16_t movingDistance, uint8_t movingEnergy, uint16_t stationaryDistance, uint8_t stationaryEnergy, uint16_t detection) {
+	targetType = type;
+	movingTargetDistance = movingDistance;
+	movingTargetEnergy = movingEnergy;
+	stationaryTargetDistance = stationaryDistance;
+	stationaryTargetEnergy = stationaryEnergy;
+	detectionDistance = detection;
+}
+
+void LD2410Simulator::setGateEnergy(uint8_t gate, uint8_t moving, uint8_t stationary) {
+	if (gate < LD2410_MAX_GATES)
+	{
+		movingEnergy[gate] = moving;
+		stationaryEnergy[gate] = stationary;
+	}
+}
+
+uint16_t LD2410Simulator::burst(uint16_t frames) {
+	uint32_t dropped = statistics.framesDropped;
+	uint16_t queued = 0;
+	while (queued < frames)
+	{
+		queue_report_();
+		if (statistics.framesDropped != dropped)
+		{
+			break;
+		}
+		queued++;
+	}
+	return queued;
+}
+
+void LD2410Simulator::factoryReset() {
+	max_moving_gate = 8;
+	max_stationary_gate = 8;
+	sensor_idle_time = 5;
+	memcpy(motion_sensitivity, LD2410_SIMULATOR_DEFAULT_MOTION_SENSITIVITY, LD2410_MAX_GATES);
+	memcpy(stationary_sensitivity, LD2410_SIMULATOR_DEFAULT_STATIONARY_SENSITIVITY, LD2410_MAX_GATES);
+	distance_resolution = 0;
+	baud_rate_index = 7;
+}
+
+const LD2410SimulatorStats& LD2410Simulator::stats() {
+	return statistics;
+}
+
+bool LD2410Simulator::inConfigurationMode() {
+	return configurationMode;
+}
+
+bool LD2410Simulator::inEngineeringMode() {
+	return engineeringMode;
+}
+
+void LD2410Simulator::service_() {
+	uint32_t now = micros();
+	if (restarting && (int32_t)(now - restartUntil) >= 0)
+	{
+		restarting = false;
+		reportScheduled = false;
+	}
+	if (reportInterval > 0 && configurationMode == false && restarting == false)		//The sensor stops reporting while it is being configured
+	{
+		if (reportScheduled == false)
+		{
+			nextReport = now + reportInterval;
+			reportScheduled = true;
+		}
+		uint8_t generated = 0;
+		while ((int32_t)(now - nextReport) >= 0)
+		{
+			if (generated < LD2410_SIMULATOR_MAX_CATCH_UP)
+			{
+				queue_report_();
+				generated++;
+			}
+			nextReport += reportInterval;
+		}
+	}
+	else
+	{
+		reportScheduled = false;
+	}
+	if (baudRate == 0)
+	{
+		outputReleased = outputCount;
+	}
+	else
+	{
+		releaseCredit += (uint64_t)(now - lastRelease) * baudRate;
+		lastRelease = now;
+		uint64_t bytes = releaseCredit / 10000000ULL;				//Ten bits a byte, a million microseconds a second
+		releaseCredit -= bytes * 10000000ULL;
+		if (outputReleased + bytes >= outputCount)
+		{
+			outputReleased = outputCount;
+			releaseCredit = 0;										//An idle line does not bank time for later bytes
+		}
+		else
+		{
+			outputReleased += bytes;
+		}
+	}
+}
+
+bool LD2410Simulator::queue_(const uint8_t* bytes, uint16_t length) {
+	if (length > LD2410_SIMULATOR_BUFFER_LENGTH - outputCount)
+	{
+		statistics.framesDropped++;
+		return false;
+	}
+	for (uint16_t i = 0; i < length; i++)
+	{
+		output[(outputHead + outputCount) & (LD2410_SIMULATOR_BUFFER_LENGTH - 1)] = bytes[i];
+		outputCount++;
+	}
+	return true;
+}
+
+void LD2410Simulator::queue_report_() {
+	uint8_t frame[LD2410_MAX_FRAME_LENGTH];
+	if (noise > 0 && random_() % 1000 < noise)
+	{
+		uint8_t noiseLength = 1 + random_() % 8;
+		for (uint8_t i = 0; i < noiseLength; i++)
+		{
+			frame[i] = random_();
+		}
+		if (queue_(frame, noiseLength))
+		{
+			statistics.noiseBytes += noiseLength;
+		}
+	}
+	uint16_t length = encode_report_(frame);
+	bool truncated = truncation > 0 && random_() % 1000 < truncation;
+	if (truncated)
+	{
+		length = 1 + random_() % (length - 1);
+	}
+	if (queue_(frame, length))
+	{
+		statistics.framesGenerated++;
+		if (truncated)
+		{
+			statistics.framesTruncated++;
+		}
+	}
+}
+
+uint16_t LD2410Simulator::encode_report_(uint8_t* frame) {
+	uint16_t position = 0;
+	frame[position++] = 0xF4;
+	frame[position++] = 0xF3;
+	frame[position++] = 0xF2;
+	frame[position++] = 0xF1;
+	position += 2;													//Length, filled in once the payload is known
+	frame[position++] = engineeringMode ? 0x01 : 0x02;
+	frame[position++] = 0xAA;
+	frame[position++] = targetType;
+	frame[position++] = (uint8_t)(movingTargetDistance);
+	frame[position++] = (uint8_t)(movingTargetDistance >> 8);
+	frame[position++] = movingTargetEnergy;
+	frame[position++] = (uint8_t)(stationaryTargetDistance);
+	frame[position++] = (uint8_t)(stationaryTargetDistance >> 8);
+	frame[position++] = stationaryTargetEnergy;
+	frame[position++] = (uint8_t)(detectionDistance);
+	frame[position++] = (uint8_t)(detectionDistance >> 8);
+	if (engineeringMode)
+	{
+		frame[position++] = LD2410_MAX_GATES - 1;					//Highest moving gate reported
+		frame[position++] = LD2410_MAX_GATES - 1;					//Highest stationary gate reported
+		memcpy(&frame[position], movingEnergy, LD2410_MAX_GATES);
+		position += LD2410_MAX_GATES;
+		memcpy(&frame[position], stationaryEnergy, LD2410_MAX_GATES);
+		position += LD2410_MAX_GATES;
+		frame[position++] = 0x00;									//Additional information, unused
+		frame[position++] = 0x00;
+	}
+	frame[position++] = 0x55;
+	frame[position++] = 0x00;
+	frame[4] = (uint8_t)(position - 6);
+	frame[5] = (uint8_t)((position - 6) >> 8);
+	frame[position++] = 0xF8;
+	frame[position++] = 0xF7;
+	frame[position++] = 0xF6;
+	frame[position++] = 0xF5;
+	return position;
+}
+
+void LD2410Simulator::queue_ack_(uint8_t ack, bool success, const uint8_t* payload, uint8_t payloadLength) {
+	uint8_t frame[LD2410_MAX_FRAME_LENGTH] = { 0xFD, 0xFC, 0xFB, 0xFA, (uint8_t)(payloadLength + 4), 0x00, ack, 0x01, (uint8_t)(success ? 0x00 : 0x01), 0x00 };
+	if (payloadLength > 0)
+	{
+		memcpy(&frame[10], payload, payloadLength);
+	}
+	frame[10 + payloadLength] = 0x04;
+	frame[11 + payloadLength] = 0x03;
+	frame[12 + payloadLength] = 0x02;
+	frame[13 + payloadLength] = 0x01;
+	if (queue_(frame, payloadLength + 14))
+	{
+		statistics.acksSent++;
+		unreadAcks[(unreadAckHead + unreadAckCount++) & (LD2410_SIMULATOR_MAX_UNREAD_ACKS - 1)] = { outputRead + outputCount, (uint8_t)commandLength };
+		commandBytes += commandLength;
+		if (commandBytes > statistics.commandBytesPeak)
+		{
+			statistics.commandBytesPeak = commandBytes;
+		}
+	}
+}
+
+bool LD2410Simulator::receive_command_byte_(uint8_t byte) {
+	static const uint8_t header[4] = { 0xFD, 0xFC, 0xFB, 0xFA };
+	static const uint8_t footer[4] = { 0x04, 0x03, 0x02, 0x01 };
+	if (commandPosition < 4 && byte != header[commandPosition])
+	{
+		commandPosition = byte == header[0] ? 1 : 0;				//Resynchronise on the next header
+		command[0] = byte;
+		return false;
+	}
+	command[commandPosition++] = byte;
+	if (commandPosition == 6)
+	{
+		commandLength = command[4] + (command[5] << 8) + 10;
+		if (commandLength > LD2410_MAX_COMMAND_FRAME_LENGTH || commandLength < 12)
+		{
+			commandPosition = 0;
+		}
+	}
+	else if (commandPosition > 6 && commandPosition == commandLength)
+	{
+		commandPosition = 0;
+		return memcmp(&command[commandLength - 4], footer, 4) == 0;
+	}
+	return false;
+}
+
+bool LD2410Simulator::parameter_(uint8_t index, uint16_t& word, uint32_t& value) {
+	uint8_t position = 8 + index * 6;
+	if (position + 6 > commandLength - 4)
+	{
+		return false;
+	}
+	word = command[position] + (command[position + 1] << 8);
+	value = command[position + 2] + (command[position + 3] << 8) + ((uint32_t)command[position + 4] << 16) + ((uint32_t)command[position + 5] << 24);
+	return true;
+}
+
+void LD2410Simulator::handle_command_() {
+	statistics.commandsReceived++;
+	uint8_t opcode = command[6];
+	if (responsive == false)
+	{
+		return;
+	}
+	if (opcode == 0xFF)
+	{
+		static const uint8_t protocol[4] = { 0x01, 0x00, LD2410_SIMULATOR_COMMAND_BUFFER & 0xFF, LD2410_SIMULATOR_COMMAND_BUFFER >> 8 };	//Protocol version 1 and the buffer size
+		configurationMode = true;
+		queue_ack_(opcode, true, protocol, sizeof(protocol));
+		return;
+	}
+	if (configurationMode == false)
+	{
+		statistics.commandsIgnored++;
+		return;
+	}
+	uint16_t word;
+	switch (opcode)
+	{
+	case 0xFE:														//Leave configuration mode
+		configurationMode = false;
+		queue_ack_(opcode, true);
+		break;
+	case 0x60:														//Max gates and idle time
+	{
+		uint32_t values[3];
+		bool valid = true;
+		for (uint8_t i = 0; i < 3 && valid; i++)
+		{
+			valid = parameter_(i, word, values[i]) && word == i;
+		}
+		valid = valid && values[0] >= 2 && values[0] <= 8 && values[1] >= 2 && values[1] <= 8 && values[2] <= 0xFFFF;
+		if (valid)
+		{
+			max_moving_gate = values[0];
+			max_stationary_gate = values[1];
+			sensor_idle_time = values[2];
+		}
+		queue_ack_(opcode, valid);
+		break;
+	}
+	case 0x61:														//Read configuration
+	{
+		uint8_t payload[24];
+		payload[0] = 0xAA;
+		payload[1] = LD2410_MAX_GATES - 1;
+		payload[2] = max_moving_gate;
+		payload[3] = max_stationary_gate;
+		memcpy(&payload[4], motion_sensitivity, LD2410_MAX_GATES);
+		memcpy(&payload[4 + LD2410_MAX_GATES], stationary_sensitivity, LD2410_MAX_GATES);
+		payload[22] = (uint8_t)(sensor_idle_time);
+		payload[23] = (uint8_t)(sensor_idle_time >> 8);
+		queue_ack_(opcode, true, payload, sizeof(payload));
+		break;
+	}
+	case 0x62:														//Engineering mode on
+	case 0x63:														//Engineering mode off
+		engineeringMode = opcode == 0x62;
+		queue_ack_(opcode, true);
+		break;
+	case 0x64:														//Gate sensitivity
+	{
+		uint32_t values[3];
+		bool valid = true;
+		for (uint8_t i = 0; i < 3 && valid; i++)
+		{
+			valid = parameter_(i, word, values[i]) && word == i;
+		}
+		valid = valid && (values[0] < LD2410_MAX_GATES || values[0] == 0xFFFF) && values[1] <= 100 && values[2] <= 100;
+		if (valid)
+		{
+			for (uint8_t gate = 0; gate < LD2410_MAX_GATES; gate++)
+			{
+				if (values[0] == 0xFFFF || values[0] == gate)
+				{
+					motion_sensitivity[gate] = values[1];
+					stationary_sensitivity[gate] = values[2];
+				}
+			}
+		}
+		queue_ack_(opcode, valid);
+		break;
+	}
+	case 0xA0:														//Firmware version
+	{
+		uint8_t payload[8] = { 0x00, 0x01, firmware_minor_version, firmware_major_version,
+			(uint8_t)firmware_bugfix_version, (uint8_t)(firmware_bugfix_version >> 8), (uint8_t)(firmware_bugfix_version >> 16), (uint8_t)(firmware_bugfix_version >> 24) };
+		queue_ack_(opcode, true, payload, sizeof(payload));
+		break;
+	}
+	case 0xA1:														//Baud rate, takes effect after a restart
+	{
+		uint16_t index = command[8] + (command[9] << 8);
+		bool valid = commandLength == 14 && index >= 1 && index <= 8;
+		if (valid)
+		{
+			baud_rate_index = index;
+		}
+		queue_ack_(opcode, valid);
+		break;
+	}
+	case 0xA2:														//Factory reset, applied straight away rather than after a restart
+		factoryReset();
+		queue_ack_(opcode, true);
+		break;
+	case 0xA3:														//Restart, the sensor drops out of configuration mode and goes quiet for a while
+		queue_ack_(opcode, true);
+		configurationMode = false;
+		engineeringMode = false;
+		restarting = true;
+		restartUntil = micros() + LD2410_SIMULATOR_RESTART_TIME * 1000UL;
+		break;
+	case 0xA5:														//MAC address
+		queue_ack_(opcode, true, mac_address, sizeof(mac_address));
+		break;
+	case 0xAA:														//Distance resolution
+	{
+		uint16_t resolution = command[8] + (command[9] << 8);
+		bool valid = commandLength == 14 && resolution <= 1;
+		if (valid)
+		{
+			distance_resolution = resolution;
+		}
+		queue_ack_(opcode, valid);
+		break;
+	}
+	case 0xAB:														//Read distance resolution
+	{
+		uint8_t payload[2] = { (uint8_t)(distance_resolution), (uint8_t)(distance_resolution >> 8) };
+		queue_ack_(opcode, true, payload, sizeof(payload));
+		break;
+	}
+	default:														//The sensor answers unknown commands with a failure status
+		queue_ack_(opcode, false);
+		break;
+	}
+}
+
+uint32_t LD2410Simulator::random_() {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
@@ -0,0 +1,118 @@
+/*
+ *	An emulated Hi-Link LD2410 for exercising the LD2410 library without a sensor.
+ *
+ *	The simulator is a Stream, so it can be handed to LD2410 in place of the UART. Bytes the library writes are parsed
+ *	as command frames and answered with the same ACK frames the sensor sends; reads return ACKs and a stream of normal
+ *	or engineering data frames generated at a configurable rate. Noise bytes, truncated frames and bursts can be
+ *	injected to measure how the library resynchronises, and an optional baud rate paces the bytes the way a real UART would.
+ *
+ *	Time comes from micros(), so the caller advances the stream by calling available() or read() as the library does.
+ */
+#ifndef LD2410_SIMULATOR_H
+#define LD2410_SIMULATOR_H
+#include <Arduino.h>
+#include "Radar/LD2410/LD2410.h"
+
+#define LD2410_SIMULATOR_BUFFER_LENGTH 512						//Bytes queued towards the library, a power of two
+#define LD2410_SIMULATOR_MAX_CATCH_UP 8							//Reports generated per call when time has jumped, the rest are skipped
+#define LD2410_SIMULATOR_RESTART_TIME 1000						//Milliseconds without reports after a restart command
+#define LD2410_SIMULATOR_COMMAND_BUFFER 64						//Command bytes held until their ACKs are read, reported on entering configuration mode
+#define LD2410_SIMULATOR_MAX_UNREAD_ACKS 8						//ACKs tracked against the command buffer, a power of two
+
+struct LD2410SimulatorStats {
+	uint32_t framesGenerated = 0;									//Data frames queued, including truncated ones
+	uint32_t framesTruncated = 0;
+	uint32_t framesDropped = 0;										//Frames and ACKs that did not fit in the buffer
+	uint32_t noiseBytes = 0;
+	uint32_t commandsReceived = 0;
+	uint32_t commandsIgnored = 0;									//Commands sent outside configuration mode, which the sensor does not answer
+	uint32_t acksSent = 0;
+	uint32_t commandsOverflowed = 0;								//Commands lost because the command buffer was full
+	uint32_t commandBytesPeak = 0;									//Most command bytes held at once
+};
+
+class LD2410Simulator : public Stream {
+
+public:
+	LD2410Simulator(uint32_t seed = 1);								//Seed for the noise and truncation generator
+	int available() override;
+	int read() override;
+	int peek() override;
+	void flush() override;
+	size_t write(uint8_t byte) override;							//Command bytes from the library
+	using Print::write;
+	void setReportRate(uint16_t framesPerSecond);					//0 stops reports, the sensor itself reports at about 10 per second
+	void setBaudRate(uint32_t baud);								//0 releases bytes as soon as they are queued
+	void setNoise(uint16_t perMille);								//Chance of a run of random bytes before each report
+	void setTruncation(uint16_t perMille);							//Chance of a report being cut short
+	void setResponsive(bool responsive);							//Stop answering commands to exercise timeouts
+	void setEngineeringMode(bool enabled);
+	void setTarget(uint8_t type, uint16_t movingDistance, uint8_t movingEnergy, uint16_t stationaryDistance, uint8_t stationaryEnergy, uint16_t detectionDistance);
+	void setGateEnergy(uint8_t gate, uint8_t moving, uint8_t stationary);
+	uint16_t burst(uint16_t frames);								//Queue reports immediately, returns how many fit
+	void factoryReset();											//Restore the default configuration
+	const LD2410SimulatorStats& stats();
+	bool inConfigurationMode();
+	bool inEngineeringMode();
+	uint8_t max_moving_gate = 8;
+	uint8_t max_stationary_gate = 8;
+	uint16_t sensor_idle_time = 5;
+	uint8_t motion_sensitivity[LD2410_MAX_GATES];
+	uint8_t stationary_sensitivity[LD2410_MAX_GATES];
+	uint16_t distance_resolution = 0;
+	uint16_t baud_rate_index = 7;									//256000 baud
+	uint8_t firmware_major_version = 1;
+	uint8_t firmware_minor_version = 2;
+	uint32_t firmware_bugfix_version = 0x22062416;
+	uint8_t mac_address[6] = { 0x8F, 0x27, 0x2E, 0xB8, 0x0F, 0x65 };
+private:
+	uint8_t output[LD2410_SIMULATOR_BUFFER_LENGTH];					//Bytes on their way to the library
+	uint16_t outputHead = 0;
+	uint16_t outputCount = 0;
+	uint16_t outputReleased = 0;									//Bytes the baud rate has let through so far
+	uint32_t outputRead = 0;										//Bytes the library has read in total
+	struct unread_ack_ {
+		uint32_t end;												//outputRead once the ACK's last byte is read
+		uint8_t commandLength;										//Bytes of the command it answers
+	};
+	unread_ack_ unreadAcks[LD2410_SIMULATOR_MAX_UNREAD_ACKS];		//Commands held in the command buffer until their ACK is read
+	uint8_t unreadAckHead = 0;
+	uint8_t unreadAckCount = 0;
+	uint16_t commandBytes = 0;										//Command bytes held, the sensor drops a command that does not fit
+	uint8_t command[LD2410_MAX_COMMAND_FRAME_LENGTH];				//Command frame being received
+	uint8_t commandPosition = 0;
+	uint16_t commandLength = 0;
+	bool configurationMode = false;
+	bool engineeringMode = false;
+	bool responsive = true;
+	uint32_t reportInterval = 100000;								//Microseconds between reports, zero when stopped
+	uint32_t nextReport = 0;
+	bool reportScheduled = false;
+	uint32_t baudRate = 0;
+	uint32_t lastRelease = 0;
+	uint64_t releaseCredit = 0;										//Microseconds times baud not yet spent on a whole byte
+	uint32_t restartUntil = 0;
+	bool restarting = false;
+	uint16_t noise = 0;
+	uint16_t truncation = 0;
+	uint32_t randomState;
+	uint8_t targetType = 0x03;
+	uint16_t movingTargetDistance = 120;
+	uint8_t movingTargetEnergy = 60;
+	uint16_t stationaryTargetDistance = 80;
+	uint8_t stationaryTargetEnergy = 100;
+	uint16_t detectionDistance = 120;
+	uint8_t movingEnergy[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
+	uint8_t stationaryEnergy[LD2410_MAX_GATES] = { 0,0,0,0,0,0,0,0,0 };
+	LD2410SimulatorStats statistics;
+	void service_();												//Generate reports that are due and release bytes at the baud rate
+	bool queue_(const uint8_t* bytes, uint16_t length);				//All or nothing, so a frame is never split by a full buffer
+	void queue_report_();
+	uint16_t encode_report_(uint8_t* frame);
+	void queue_ack_(uint8_t ack, bool success, const uint8_t* payload = nullptr, uint8_t payloadLength = 0);
+	bool receive_command_byte_(uint8_t byte);						//True when a complete command frame has arrived
+	void handle_command_();
+	bool parameter_(uint8_t index, uint16_t& word, uint32_t& value);	//Word and value pair at index in a parameterised command
+	uint32_t random_();
+};
+#endif
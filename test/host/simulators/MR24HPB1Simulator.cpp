@@ -0,0 +1,333 @@
+#include "Arduino.h"
+#include "MR24HPB1Simulator.h"
+
+namespace MR24HPB1 {
+    Simulator::Simulator(uint32_t seed) {
+        _random = seed != 0 ? seed : 1;
+        _lastRelease = micros();
+    }
+
+    int Simulator::available() {
+        service();
+        return _outputReleased;
+    }
+
+    int Simulator::read() {
+        service();
+        if (_outputReleased == 0) {
+            return -1;
+        }
+        uint8_t byte = _output[_outputHead];
+        _outputHead = (_outputHead + 1) & (MR24HPB1_SIMULATOR_BUFFER_LENGTH - 1);
+        _outputCount--;
+        _outputReleased--;
+        return byte;
+    }
+
+    int Simulator::peek() {
+        service();
+        return _outputReleased > 0 ? _output[_outputHead] : -1;
+    }
+
+    void Simulator::flush() {
+    }
+
+    size_t Simulator::write(uint8_t byte) {
+        if (receive(byte)) {
+            handleCommand();
+        }
+        return 1;
+    }
+
+    void Simulator::setReportInterval(Report::Type type, uint32_t intervalMicros) {
+        _reportInterval[type] = intervalMicros;
+        _reportScheduled[type] = false;
+    }
+
+    void Simulator::setStateChangeInterval(uint32_t intervalMicros) {
+        _stateChangeInterval = intervalMicros;
+        _stateChangeScheduled = false;
+    }
+
+    void Simulator::setBaudRate(uint32_t baud) {
+        service();
+        _baudRate = baud;
+        _releaseCredit = 0;
+        _lastRelease = micros();
+    }
+
+    void Simulator::setCorruption(uint16_t perMille) {
+        _corruption = perMille;
+    }
+
+    void Simulator::registerPinCallback(PinCallback callback) {
+        _pinCallback = callback;
+    }
+
+    void Simulator::setEnvironment(environmental_state_t state) {
+        if (state == _environment) {
+            return;
+        }
+        _environment = state;
+        _stats.stateChanges++;
+        if (_pinCallback != NULL) {
+            _pinCallback(getS1(), getS2());
+        }
+        report(Report::ENVIRONMENT); // The sensor reports a change straight away
+    }
+
+    void Simulator::setMotorSigns(float signs) {
+        _motorSigns = signs;
+    }
+
+    void Simulator::setApproachAway(away_state_t state) {
+        _approachAway = state;
+        report(Report::APPROACH_AWAY);
+    }
+
+    void Simulator::abnormalReset() {
+        uint8_t data = 0x0F;
+        report(Command::ACTIVE_REPORT, OTHER, ABNORMAL_RESET, &data, 1);
+    }
+
+    bool Simulator::getS1() {
+        return _environment != UNOCCUPIED;
+    }
+
+    bool Simulator::getS2() {
+        return _environment == EXERCISING;
+    }
+
+    void Simulator::service() {
+        uint32_t now = micros();
+        if (_rebooting && (int32_t)(now - _rebootUntil) >= 0) {
+            _rebooting = false;
+            for (uint8_t type = 0; type < Report::COUNT; type++) {
+                _reportScheduled[type] = false;
+            }
+        }
+        if (!_rebooting) {
+            if (_stateChangeInterval > 0) {
+                if (!_stateChangeScheduled) {
+                    _nextStateChange = now + _stateChangeInterval;
+                    _stateChangeScheduled = true;
+                }
+                if ((int32_t)(now - _nextStateChange) >= 0) {
+                    setEnvironment(static_cast<environmental_state_t>((_environment + 1 + nextRandom() % 2) % 3)); // Any state but the current one
+                    _nextStateChange = now + _stateChangeInterval;
+                }
+            }
+            for (uint8_t type = 0; type < Report::COUNT; type++) {
+                if (_reportInterval[type] == 0) {
+                    continue;
+                }
+                if (!_reportScheduled[type]) {
+                    _nextReport[type] = now + _reportInterval[type];
+                    _reportScheduled[type] = true;
+                }
+                uint8_t generated = 0;
+                while ((int32_t)(now - _nextReport[type]) >= 0) {
+                    if (generated < MR24HPB1_SIMULATOR_MAX_CATCH_UP) {
+                        report(static_cast<Report::Type>(type));
+                        generated++;
+                    }
+                    _nextReport[type] += _reportInterval[type];
+                }
+            }
+        }
+        if (_baudRate == 0) {
+            _outputReleased = _outputCount;
+            return;
+        }
+        _releaseCredit += (uint64_t)(now - _lastRelease) * _baudRate;
+        _lastRelease = now;
+        uint64_t bytes = _releaseCredit / 10000000ULL; // Ten bits a byte, a million microseconds a second
+        _releaseCredit -= bytes * 10000000ULL;
+        if (_outputReleased + bytes >= _outputCount) {
+            _outputReleased = _outputCount;
+            _releaseCredit = 0; // An idle line does not bank time for later bytes
+        } else {
+            _outputReleased += bytes;
+        }
+    }
+
+    bool Simulator::queue(const uint8_t *bytes, uint16_t length) {
+        if (length > MR24HPB1_SIMULATOR_BUFFER_LENGTH - _outputCount) {
+            _stats.framesDropped++;
+            return false;
+        }
+        for (uint16_t i = 0; i < length; i++) {
+            _output[(_outputHead + _outputCount) & (MR24HPB1_SIMULATOR_BUFFER_LENGTH - 1)] = bytes[i];
+            _outputCount++;
+        }
+        return true;
+    }
+
+    void Simulator::report(uint8_t functionCode, uint8_t address1, uint8_t address2, const uint8_t *data, uint8_t length) {
+        uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+        uint8_t frameLength = buildFrame(frame, functionCode, address1, address2, data, length);
+        if (frameLength == 0) {
+            return;
+        }
+        bool corrupted = _corruption > 0 && nextRandom() % 1000 < _corruption;
+        if (corrupted) {
+            frame[1 + nextRandom() % (frameLength - 1)] ^= 1 << (nextRandom() % 8); // Never the header, so the driver still sees a frame start
+        }
+        if (queue(frame, frameLength)) {
+            _stats.framesGenerated++;
+            if (corrupted) {
+                _stats.framesCorrupted++;
+            }
+        }
+    }
+
+    void Simulator::report(Report::Type type) {
+        switch (type) {
+            case Report::ENVIRONMENT:
+                reportValue(Command::ACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS);
+                break;
+            case Report::MOTOR_SIGNS:
+                reportValue(Command::ACTIVE_REPORT, RADAR_INFO, MOTOR_SIGNS);
+                break;
+            case Report::APPROACH_AWAY:
+                reportValue(Command::ACTIVE_REPORT, RADAR_INFO, APPROACHING_AWAY_STATE);
+                break;
+            case Report::HEARTBEAT: {
+                uint8_t data[3];
+                environmentBytes(data);
+                report(Command::ACTIVE_REPORT, OTHER, HEARTBEAT, data, sizeof(data));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    bool Simulator::reportValue(uint8_t functionCode, uint8_t address1, uint8_t address2) {
+        uint16_t address = (address1 << 8) | address2;
+        switch (address) {
+            case 0x0101: // Device ID
+            case 0x0102: // Software version
+            case 0x0103: // Hardware version
+            case 0x0104: { // Protocol version
+                static const char *const info[] = {"MR24HPB1SIM", "G24VD1SYV001006", "G24VD1SYH01", "V1.0"};
+                const char *value = info[address2 - 1];
+                report(functionCode, address1, address2, reinterpret_cast<const uint8_t *>(value), strlen(value));
+                return true;
+            }
+            case 0x0305: { // Environment status
+                uint8_t data[3];
+                environmentBytes(data);
+                report(functionCode, address1, address2, data, sizeof(data));
+                return true;
+            }
+            case 0x0306: { // Motor signs
+                FB signs;
+                signs.F = _motorSigns;
+                report(functionCode, address1, address2, signs.B, sizeof(signs.B));
+                return true;
+            }
+            case 0x0307: { // Approaching or going away
+                uint8_t data[3] = {0x01, 0x01, static_cast<uint8_t>(_approachAway)};
+                report(functionCode, address1, address2, data, sizeof(data));
+                return true;
+            }
+            case 0x040C: // Threshold gear
+                report(functionCode, address1, address2, &_threshold, 1);
+                return true;
+            case 0x0410: // Scene setting
+                report(functionCode, address1, address2, &_scene, 1);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void Simulator::environmentBytes(uint8_t *data) {
+        switch (_environment) {
+            case STATIONARY:
+                data[0] = 0x01;
+                data[1] = 0x00;
+                data[2] = 0xFF;
+                break;
+            case EXERCISING:
+                data[0] = 0x01;
+                data[1] = 0x01;
+                data[2] = 0x01;
+                break;
+            default:
+                data[0] = 0x00;
+                data[1] = 0xFF;
+                data[2] = 0xFF;
+                break;
+        }
+    }
+
+    bool Simulator::receive(uint8_t byte) {
+        if (_commandPosition == 0 && byte != HEADER) {
+            return false;
+        }
+        _command[_commandPosition++] = byte;
+        if (_commandPosition == 3) {
+            _commandLength = (_command[1] | (_command[2] << 8)) + 1;
+            if (_commandLength < 8 || _commandLength > sizeof(_command)) {
+                _commandPosition = 0;
+            }
+        } else if (_commandPosition > 3 && _commandPosition == _commandLength) {
+            _commandPosition = 0;
+            return true;
+        }
+        return false;
+    }
+
+    void Simulator::handleCommand() {
+        _stats.commandsReceived++;
+        uint16_t crc = getCRC16(_command, _commandLength - 2);
+        if (highByte(crc) != _command[_commandLength - 2] || lowByte(crc) != _command[_commandLength - 1]) {
+            _stats.commandsRejected++;
+            return;
+        }
+        uint8_t functionCode = _command[3];
+        uint8_t address1 = _command[4];
+        uint8_t address2 = _command[5];
+        uint8_t dataLength = _commandLength - 8;
+        uint16_t address = (address1 << 8) | address2;
+        bool accepted = false;
+        if (functionCode == Command::READ) {
+            accepted = reportValue(Command::PASSIVE_REPORT, address1, address2);
+        } else if (functionCode == Command::WRITE) {
+            uint8_t value = dataLength > 0 ? _command[6] : 0;
+            switch (address) {
+                case 0x040C: // Threshold gear
+                    accepted = dataLength == 1 && value >= 1 && value <= 10;
+                    if (accepted) {
+                        _threshold = value;
+                        reportValue(Command::PASSIVE_REPORT, address1, address2);
+                    }
+                    break;
+                case 0x0410: // Scene setting
+                    accepted = dataLength == 1 && value <= HOTEL + 1;
+                    if (accepted) {
+                        _scene = value;
+                        reportValue(Command::PASSIVE_REPORT, address1, address2);
+                    }
+                    break;
+                case 0x0504: // Reboot, the sensor goes quiet and then reports from scratch
+                    accepted = true;
+                    _rebooting = true;
+                    _rebootUntil = micros() + MR24HPB1_SIMULATOR_REBOOT_TIME * 1000UL;
+                    break;
+            }
+        }
+        if (!accepted) {
+            _stats.commandsRejected++;
+        }
+    }
+
+    uint32_t Simulator::nextRandom() {
+        _random ^= _random << 13;
+        _random ^= _random >> 17;
+        _random ^= _random << 5;
+        return _random;
+    }
+};
@@ -0,0 +1,117 @@
+#ifndef MR24HPB1_SIMULATOR_H
+#define MR24HPB1_SIMULATOR_H
+
+#include <functional>
+#include "Arduino.h"
+#include "Radar/MR24HPB1/MR24HPB1.h"
+
+#define MR24HPB1_SIMULATOR_BUFFER_LENGTH 256 // Bytes queued towards the driver, a power of two
+#define MR24HPB1_SIMULATOR_MAX_CATCH_UP 4 // Reports of one kind generated per call when time has jumped
+#define MR24HPB1_SIMULATOR_REBOOT_TIME 1000 // Milliseconds without reports after a reboot command
+
+namespace MR24HPB1
+{
+    /*
+     * An emulated MR24HPB1 that plugs into MR24HPB1 or Radar in place of the UART.
+     *
+     * Reports are 0x55 framed with the CRC16 the sensor uses and go out at configurable rates. Frames the driver
+     * writes are CRC checked and answered: reads with a passive report of the value, writes by applying and echoing it.
+     * Corrupted frames can be mixed in, and the S1/S2 pin levels follow the simulated environment so a pin callback
+     * can drive digitalRead() stand-ins or real outputs. Time comes from micros().
+     */
+    class Simulator : public Stream
+    {
+    public:
+        struct Report
+        {
+            enum Type
+            {
+                ENVIRONMENT,
+                MOTOR_SIGNS,
+                APPROACH_AWAY,
+                HEARTBEAT,
+                COUNT
+            };
+        };
+
+        struct Stats
+        {
+            uint32_t framesGenerated = 0;
+            uint32_t framesCorrupted = 0;
+            uint32_t framesDropped = 0; // Did not fit in the buffer
+            uint32_t commandsReceived = 0;
+            uint32_t commandsRejected = 0; // Bad CRC or unknown address
+            uint32_t stateChanges = 0;
+        };
+
+        typedef std::function<void(bool s1, bool s2)> PinCallback;
+
+        Simulator(uint32_t seed = 1);
+        int available() override;
+        int read() override;
+        int peek() override;
+        void flush() override;
+        size_t write(uint8_t byte) override; // Command bytes from the driver
+        using Print::write;
+
+        void setReportInterval(Report::Type report, uint32_t intervalMicros); // 0 stops that report
+        void setStateChangeInterval(uint32_t intervalMicros); // Random environment changes, 0 leaves it to setEnvironment()
+        void setBaudRate(uint32_t baud); // 0 releases bytes as soon as they are queued
+        void setCorruption(uint16_t perMille); // Chance of a frame having one byte flipped
+        void registerPinCallback(PinCallback callback);
+
+        void setEnvironment(environmental_state_t state); // Reports the change and moves S1/S2
+        void setMotorSigns(float signs);
+        void setApproachAway(away_state_t state);
+        void abnormalReset(); // Queue an abnormal reset report
+
+        bool getS1(); // High while anyone is present
+        bool getS2(); // High while there is movement
+        uint8_t getThreshold() { return _threshold; }
+        uint8_t getScene() { return _scene; }
+        const Stats &stats() { return _stats; }
+
+    private:
+        uint8_t _output[MR24HPB1_SIMULATOR_BUFFER_LENGTH];
+        uint16_t _outputHead = 0;
+        uint16_t _outputCount = 0;
+        uint16_t _outputReleased = 0;
+        uint8_t _command[MR24HPB1_MAX_FRAME_LENGTH]; // Largest frame the sensor accepts
+        uint8_t _commandPosition = 0;
+        uint16_t _commandLength = 0;
+
+        uint32_t _reportInterval[Report::COUNT] = {1000000, 1000000, 0, 30000000}; // Microseconds, 0 when stopped
+        uint32_t _nextReport[Report::COUNT] = {0, 0, 0, 0};
+        bool _reportScheduled[Report::COUNT] = {false, false, false, false};
+        uint32_t _stateChangeInterval = 0;
+        uint32_t _nextStateChange = 0;
+        bool _stateChangeScheduled = false;
+        uint32_t _baudRate = 0;
+        uint32_t _lastRelease = 0;
+        uint64_t _releaseCredit = 0;
+        bool _rebooting = false;
+        uint32_t _rebootUntil = 0;
+        uint16_t _corruption = 0;
+        uint32_t _random;
+
+        environmental_state_t _environment = UNOCCUPIED;
+        float _motorSigns = 0;
+        away_state_t _approachAway = NONE;
+        uint8_t _threshold = 7;
+        uint8_t _scene = DEFAULT_SETTING;
+        PinCallback _pinCallback;
+        Stats _stats;
+
+        void service();
+        bool queue(const uint8_t *bytes, uint16_t length);
+        void report(uint8_t functionCode, uint8_t address1, uint8_t address2, const uint8_t *data, uint8_t length);
+        void report(Report::Type type);
+        bool reportValue(uint8_t functionCode, uint8_t address1, uint8_t address2); // Current value at an address, false if unknown
+        void environmentBytes(uint8_t *data);
+        bool receive(uint8_t byte);
+        void handleCommand();
+        uint32_t nextRandom();
+    };
+};
+
+#endif
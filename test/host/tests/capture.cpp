@@ -0,0 +1,90 @@
+/*
+ * Capture and CaptureReplay: a live MR24HPB1 session is captured, drained into a sink that only takes part of
+ * each write, and replayed into a second driver, which has to see the same reports.
+ */
+#include "Util/Capture.h"
+#include "MR24HPB1Simulator.h"
+#include "check.h"
+
+// Takes at most limit bytes per write() call, like a TCPClient with a nearly full window
+struct PartialSink : public Print
+{
+    std::vector<uint8_t> bytes;
+    size_t limit;
+    size_t writes = 0;
+
+    PartialSink(size_t most) : limit(most) {}
+    size_t write(uint8_t byte) override { return write(&byte, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t taken = size < limit ? size : limit;
+        bytes.insert(bytes.end(), buffer, buffer + taken);
+        writes++;
+        return taken;
+    }
+};
+
+static void roundTrip(size_t sinkLimit)
+{
+    Host::reset();
+    MR24HPB1::Simulator simulator(11);
+    simulator.setStateChangeInterval(30000);
+    simulator.setBaudRate(9600);
+    Capture capture(simulator);
+    capture.start();
+    MR24HPB1::MR24HPB1 live(capture, 18, 19);
+    uint32_t liveStates = 0;
+    live.register_on_environmental_state([&](uint8_t) { liveStates++; });
+    live.Reboot(); // A buffered write, logged as sent bytes
+    PartialSink sink(sinkLimit);
+    for (uint16_t i = 0; i < 3000; i++)
+    {
+        live.refresh();
+        Host::advanceMicros(1000);
+        while (i % 50 == 0 && capture.pending() > 0 && capture.drain(sink) > 0)
+        {
+            // Each call stops at the first partial write, the next one carries on from there
+        }
+    }
+    while (capture.pending() > 0 && capture.drain(sink) > 0)
+    {
+    }
+    CHECK_EQUAL(0, capture.pending());
+    CHECK_EQUAL(0, capture.stats().dropped);
+    CHECK_EQUAL(sink.bytes.size(), capture.stats().drained);
+    CHECK(capture.stats().sent > 0);
+    CHECK(liveStates > 50);
+
+    CaptureReplay replay(sink.bytes.data(), sink.bytes.size());
+    CHECK(replay.valid());
+    CHECK_EQUAL(capture.stats().received, replay.received());
+    MR24HPB1::MR24HPB1 replayed(replay, 18, 19);
+    uint32_t replayedStates = 0;
+    replayed.register_on_environmental_state([&](uint8_t) { replayedStates++; });
+    while (!replay.finished())
+    {
+        replayed.refresh();
+    }
+    CHECK_EQUAL(liveStates, replayedStates);
+}
+
+int main()
+{
+    roundTrip(0xFFFF);
+    roundTrip(20);
+    roundTrip(1);
+
+    // A buffered write reaches the stream in one call and every byte is logged
+    {
+        Host::reset();
+        HardwareSerial uart;
+        Capture capture(uart);
+        capture.start();
+        const uint8_t frame[] = {0x55, 0x07, 0x00, 0x01, 0x04, 0x0C, 0xEA, 0xDB};
+        capture.write(frame, sizeof(frame));
+        CHECK_EQUAL(1, uart.writeCalls());
+        CHECK_EQUAL(sizeof(frame), uart.written().size());
+        CHECK_EQUAL(sizeof(frame), capture.stats().sent);
+    }
+    return checkResult();
+}
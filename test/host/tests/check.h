@@ -0,0 +1,49 @@
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+/*
+ * Minimal assertions for the host tests. A failed CHECK prints where and carries on, the test's main() returns
+ * checkResult() so ctest sees the failure.
+ */
+inline int &checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                          \
+    do                                                                            \
+    {                                                                             \
+        if (!(condition))                                                         \
+        {                                                                         \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures()++;                                                    \
+        }                                                                         \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual)                                                                                         \
+    do                                                                                                                        \
+    {                                                                                                                         \
+        long long expectedValue = (long long)(expected);                                                                      \
+        long long actualValue = (long long)(actual);                                                                          \
+        if (expectedValue != actualValue)                                                                                     \
+        {                                                                                                                     \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue);            \
+            checkFailures()++;                                                                                                \
+        }                                                                                                                     \
+    } while (0)
+
+inline int checkResult()
+{
+    if (checkFailures() > 0)
+    {
+        printf("%d checks failed\n", checkFailures());
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+#endif // HOST_CHECK_H
@@ -0,0 +1,70 @@
+/*
+ * MR24HPB1::FrameAssembler: frames split across reads, noise between frames and corrupted CRCs.
+ */
+#include "Radar/MR24HPB1/MR24HPB1_protocol.h"
+#include "check.h"
+
+using namespace MR24HPB1;
+
+static uint8_t environmentFrame(uint8_t *frame, uint8_t state)
+{
+    const uint8_t data[] = {state, 0x00, 0xFF};
+    return buildFrame(frame, PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, data, sizeof(data));
+}
+
+// Feeds the bytes in reads of chunk bytes and counts the frames that come out intact
+static uint32_t assemble(const std::vector<uint8_t> &bytes, int chunk)
+{
+    HardwareSerial uart;
+    uart.inject(bytes);
+    FrameAssembler assembler;
+    uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+    uint32_t frames = 0;
+    while (uart.available() > 0)
+    {
+        int pending = chunk;
+        while (pending > 0)
+        {
+            if (assembler.receive(frame, uart, pending))
+            {
+                CHECK(getCRC16(frame, assembler.length() - 2) == (frame[assembler.length() - 2] << 8 | frame[assembler.length() - 1]));
+                frames++;
+            }
+        }
+    }
+    return frames;
+}
+
+int main()
+{
+    uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+    std::vector<uint8_t> bytes;
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        uint8_t length = environmentFrame(frame, i & 1);
+        bytes.insert(bytes.end(), frame, frame + length);
+        if (i % 3 == 0)
+        {
+            bytes.push_back(0x00); // Noise between frames
+            bytes.push_back(0x13);
+        }
+    }
+    for (int chunk : {1, 2, 3, 7, 11, 64})
+        CHECK_EQUAL(20, assemble(bytes, chunk));
+
+    // A flipped bit anywhere drops only that frame
+    uint8_t length = environmentFrame(frame, 1);
+    for (uint8_t position = 3; position < length; position++)
+    {
+        std::vector<uint8_t> corrupted(frame, frame + length);
+        corrupted[position] ^= 0x04;
+        corrupted.insert(corrupted.end(), frame, frame + length);
+        CHECK_EQUAL(1, assemble(corrupted, 5));
+    }
+
+    // A header inside a frame that turned out bad starts over on the next real one
+    std::vector<uint8_t> truncated = {HEADER, 0x02, 0x00};
+    truncated.insert(truncated.end(), frame, frame + length);
+    CHECK_EQUAL(1, assemble(truncated, 4));
+    return checkResult();
+}
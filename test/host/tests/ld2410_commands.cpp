@@ -0,0 +1,120 @@
+/*
+ * LD2410 command queue against the simulator: pipelining within the buffer size it reports when entering
+ * configuration mode, and the timeouts when it stops answering.
+ */
+#include "LD2410Simulator.h"
+#include "check.h"
+
+static bool run(LD2410 &radar, LD2410CommandHandle handle)
+{
+    for (uint16_t i = 0; i < 1000; i++)
+    {
+        LD2410CommandStatus status = radar.commandStatus(handle);
+        if (status != LD2410_COMMAND_QUEUED && status != LD2410_COMMAND_IN_PROGRESS)
+            return status == LD2410_COMMAND_SUCCEEDED;
+        radar.read();
+    }
+    return false;
+}
+
+int main()
+{
+    // A full batch of 30 byte frames only pipelines as far as the 64 byte buffer allows
+    {
+        LD2410Simulator simulator;
+        simulator.setReportRate(0);
+        LD2410 radar(simulator);
+        LD2410ConfigurationBatch batch;
+        CHECK(batch.setMaxValues(6, 6, 10));
+        for (uint8_t gate = 0; gate < 8; gate++)
+            CHECK(batch.setGateSensitivityThreshold(gate, 20 + gate, 10 + gate));
+        CHECK(batch.requestCurrentConfiguration());
+        CHECK(run(radar, radar.applyConfigurationAsync(batch)));
+        for (uint8_t i = 0; i < batch.size(); i++)
+            CHECK_EQUAL(LD2410_COMMAND_SUCCEEDED, batch.status(i));
+        CHECK_EQUAL(0, simulator.stats().commandsOverflowed);
+        CHECK(simulator.stats().commandBytesPeak <= LD2410_SIMULATOR_COMMAND_BUFFER);
+        CHECK(simulator.stats().commandBytesPeak > LD2410_MAX_COMMAND_FRAME_LENGTH); // Still pipelined
+        CHECK_EQUAL(6, simulator.max_moving_gate);
+        CHECK_EQUAL(27, simulator.motion_sensitivity[7]);
+        CHECK_EQUAL(27, radar.motion_sensitivity[7]);
+        CHECK(simulator.inConfigurationMode() == false);
+    }
+
+    // Commands with the same opcode are never in flight together, their ACKs could not be told apart
+    {
+        LD2410Simulator simulator;
+        simulator.setReportRate(0);
+        LD2410 radar(simulator);
+        LD2410ConfigurationBatch batch;
+        CHECK(batch.setGateSensitivityThreshold(1, 30, 30));
+        CHECK(batch.setGateSensitivityThreshold(2, 40, 40));
+        CHECK(run(radar, radar.applyConfigurationAsync(batch)));
+        CHECK_EQUAL(LD2410_MAX_COMMAND_FRAME_LENGTH, simulator.stats().commandBytesPeak);
+        CHECK_EQUAL(30, simulator.motion_sensitivity[1]);
+        CHECK_EQUAL(40, simulator.motion_sensitivity[2]);
+    }
+
+    // A radar that never ACKs entering configuration mode times the command out, then the queue moves on
+    {
+        Host::reset();
+        LD2410Simulator simulator;
+        simulator.setReportRate(0);
+        simulator.setResponsive(false);
+        LD2410 radar(simulator);
+        LD2410CommandStatus firstStatus = LD2410_COMMAND_UNKNOWN;
+        uint32_t firstCallbacks = 0, secondCallbacks = 0;
+        LD2410CommandHandle first = radar.requestFirmwareVersionAsync([&](LD2410CommandStatus status) {
+            firstStatus = status;
+            firstCallbacks++;
+        });
+        LD2410CommandHandle second = radar.requestMacAddressAsync([&](LD2410CommandStatus) { secondCallbacks++; });
+        CHECK(first != 0 && second != 0);
+        CHECK_EQUAL(1, simulator.stats().commandsReceived); // Enter configuration mode only
+        radar.read();
+        CHECK_EQUAL(LD2410_COMMAND_IN_PROGRESS, radar.commandStatus(first));
+
+        Host::advanceMicros(99000);
+        radar.read();
+        CHECK_EQUAL(LD2410_COMMAND_IN_PROGRESS, radar.commandStatus(first)); // Not yet
+        Host::advanceMicros(1000);
+        radar.read();
+        CHECK_EQUAL(LD2410_COMMAND_TIMED_OUT, radar.commandStatus(first));
+        CHECK_EQUAL(LD2410_COMMAND_TIMED_OUT, firstStatus);
+        CHECK_EQUAL(1, firstCallbacks);
+        CHECK_EQUAL(2, simulator.stats().commandsReceived); // Leave configuration mode, in case the ACK was lost
+        CHECK_EQUAL(LD2410_COMMAND_QUEUED, radar.commandStatus(second));
+
+        simulator.setResponsive(true); // Back before the unanswered leave times out
+        Host::advanceMicros(100000);
+        CHECK(run(radar, second));
+        CHECK_EQUAL(1, secondCallbacks);
+        CHECK_EQUAL(0x65, radar.mac_address[5]);
+        radar.read(); // The leave configuration ACK
+        CHECK(radar.commandPending() == false);
+        CHECK(simulator.inConfigurationMode() == false);
+    }
+
+    // Every command times out while the radar stays silent, and each callback runs once
+    {
+        Host::reset();
+        LD2410Simulator simulator;
+        simulator.setReportRate(0);
+        simulator.setResponsive(false);
+        LD2410 radar(simulator);
+        uint32_t timedOut = 0;
+        LD2410CommandCallback count = [&](LD2410CommandStatus status) { timedOut += status == LD2410_COMMAND_TIMED_OUT; };
+        LD2410CommandHandle handles[3] = {radar.requestFirmwareVersionAsync(count), radar.requestDistanceResolutionAsync(count),
+                                          radar.requestCurrentConfigurationAsync(count)};
+        for (uint16_t i = 0; i < 100 && radar.commandPending(); i++)
+        {
+            Host::advanceMicros(50000);
+            radar.read();
+        }
+        CHECK_EQUAL(3, timedOut);
+        for (LD2410CommandHandle handle : handles)
+            CHECK_EQUAL(LD2410_COMMAND_TIMED_OUT, radar.commandStatus(handle));
+        CHECK(radar.commandPending() == false);
+    }
+    return checkResult();
+}
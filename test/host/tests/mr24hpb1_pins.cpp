@@ -0,0 +1,59 @@
+/*
+ * MR24HPB1 S1/S2 edges in interrupt mode, interleaved with the UART reports that also set presence and motion.
+ */
+#include "MR24HPB1Simulator.h"
+#include "check.h"
+
+#define S1_PIN 18
+#define S2_PIN 19
+
+int main()
+{
+    // An S1 edge queued after a UART report of the same state still calls the callbacks
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(9);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        uint32_t occupied = 0, unoccupied = 0;
+        sensor.register_on_occupied([&] { occupied++; });
+        sensor.register_on_unoccupied([&] { unoccupied++; });
+        CHECK(sensor.attachPinInterrupts());
+        sensor.refresh();
+        simulator.setEnvironment(STATIONARY);
+        sensor.refresh(); // The report arrives first
+        CHECK(sensor.getPresence());
+        Host::setPin(S1_PIN, HIGH);
+        sensor.refresh();
+        CHECK_EQUAL(1, occupied);
+        CHECK_EQUAL(0, sensor.getDroppedEdges());
+
+        simulator.setEnvironment(UNOCCUPIED);
+        sensor.refresh();
+        Host::setPin(S1_PIN, LOW);
+        sensor.refresh();
+        CHECK_EQUAL(1, unoccupied);
+        CHECK(sensor.getPresence() == false);
+    }
+
+    // Edges queued between refresh() calls are dispatched in order
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(9);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        uint32_t movements = 0, stationary = 0;
+        sensor.register_on_movement([&] { movements++; });
+        sensor.register_on_stationary([&] { stationary++; });
+        CHECK(sensor.attachPinInterrupts());
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            Host::setPin(S2_PIN, HIGH);
+            Host::setPin(S2_PIN, LOW);
+        }
+        CHECK(sensor.pinEdgesPending());
+        sensor.refresh();
+        CHECK_EQUAL(4, movements);
+        CHECK_EQUAL(4, stationary);
+        CHECK(sensor.pinEdgesPending() == false);
+    }
+    return checkResult();
+}
@@ -0,0 +1,62 @@
+/*
+ * MR24HPB1 begin() and startup() with settings the sensor accepts and settings it does not.
+ */
+#include "MR24HPB1Simulator.h"
+#include "check.h"
+
+#define S1_PIN 18
+#define S2_PIN 19
+
+int main()
+{
+    // An out of range setting fails at once and sends nothing, as setThreshold() does
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(3);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        uint32_t start = millis();
+        CHECK_EQUAL(-1, sensor.begin(0, HOTEL));
+        CHECK_EQUAL(-1, sensor.begin(11, HOTEL));
+        CHECK_EQUAL(-1, sensor.begin(5, (scene_setting_t)(HOTEL + 1)));
+        CHECK_EQUAL(-1, sensor.setThreshold(0));
+        CHECK_EQUAL(start, millis());
+        CHECK_EQUAL(0, simulator.stats().commandsReceived);
+        CHECK(sensor.startupComplete());
+    }
+
+    // Valid settings are written and confirmed by the sensor's echo
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(3);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        CHECK_EQUAL(0, sensor.begin(3, OFFICE));
+        CHECK_EQUAL(3, simulator.getThreshold());
+        CHECK_EQUAL(OFFICE, simulator.getScene());
+        CHECK_EQUAL(3, sensor.getThreshold());
+        CHECK_EQUAL(OFFICE, sensor.getSceneSetting());
+        CHECK(millis() < MR24HPB1_STARTUP_DEADLINE);
+    }
+
+    // startup() reads an out of range setting back instead of waiting for an echo that never comes
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(3);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        sensor.startup(0, HOTEL);
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_IDLE);
+        CHECK(sensor.getWriteState(CACHED_SCENE_SETTING) == WRITE_PENDING);
+        uint32_t start = millis();
+        while (!sensor.startupComplete())
+        {
+            sensor.refresh();
+            delay(2);
+        }
+        CHECK(millis() - start < MR24HPB1_STARTUP_DEADLINE);
+        CHECK(sensor.getStartupConfirmed() & (1 << CACHED_THRESHOLD));
+        CHECK(sensor.getStartupConfirmed() & (1 << CACHED_SCENE_SETTING));
+        CHECK_EQUAL(7, sensor.getThreshold()); // The simulator's default, untouched
+        CHECK_EQUAL(7, simulator.getThreshold());
+        CHECK_EQUAL(HOTEL, simulator.getScene());
+    }
+    return checkResult();
+}
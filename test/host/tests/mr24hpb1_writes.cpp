@@ -0,0 +1,138 @@
+/*
+ * MR24HPB1 non-blocking writes against a simulator that corrupts its echoes: retries, backoff, deadline and stats.
+ */
+#include "MR24HPB1Simulator.h"
+#include "check.h"
+
+#define S1_PIN 18
+#define S2_PIN 19
+#define MAX_SENDS 32 // Sends run() records
+
+// Refreshes every millisecond until the write settles or ms have passed, recording when each WRITE reached the sensor
+static uint8_t run(MR24HPB1::MR24HPB1 &sensor, MR24HPB1::Simulator &simulator, uint32_t ms, uint32_t *sentAt = nullptr)
+{
+    uint8_t sends = 0;
+    uint32_t received = simulator.stats().commandsReceived;
+    uint32_t start = millis();
+    while (millis() - start < ms)
+    {
+        sensor.refresh();
+        if (simulator.stats().commandsReceived != received)
+        {
+            received = simulator.stats().commandsReceived;
+            if (sentAt != nullptr && sends < MAX_SENDS)
+                sentAt[sends] = millis();
+            sends++;
+        }
+        if (sensor.getWriteState(CACHED_THRESHOLD) != WRITE_PENDING)
+            break; // the clock stays where it settled
+        delay(1);
+    }
+    return sends;
+}
+
+int main()
+{
+    // A clean echo confirms the write on the next refresh
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(5);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_IDLE);
+        CHECK_EQUAL(0, sensor.requestThreshold(4));
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_PENDING);
+        CHECK_EQUAL(1, simulator.stats().commandsReceived);
+        sensor.refresh();
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_CONFIRMED);
+        CHECK_EQUAL(4, sensor.getThreshold());
+        const write_stats_t &stats = sensor.getWriteStats();
+        CHECK_EQUAL(1, stats.writes);
+        CHECK_EQUAL(1, stats.confirmed);
+        CHECK_EQUAL(0, stats.retries);
+        CHECK_EQUAL(0, stats.failed);
+        CHECK_EQUAL(0, stats.last_latency);
+    }
+
+    // Asking again for the value already on its way sends nothing and keeps the backoff
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(5);
+        simulator.setCorruption(1000);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        CHECK_EQUAL(0, sensor.requestThreshold(4));
+        uint32_t sentAt[MAX_SENDS];
+        CHECK_EQUAL(1, run(sensor, simulator, 75, sentAt)); // The first retry, MR24HPB1_WRITE_RETRY after the write
+        CHECK_EQUAL(MR24HPB1_WRITE_RETRY, sentAt[0]);
+        CHECK_EQUAL(0, sensor.requestThreshold(4));
+        CHECK_EQUAL(2, simulator.stats().commandsReceived);
+        CHECK_EQUAL(1, sensor.getWriteStats().writes);
+        CHECK_EQUAL(1, run(sensor, simulator, 100, sentAt)); // Still doubled, not restarted
+        CHECK_EQUAL(3 * MR24HPB1_WRITE_RETRY, sentAt[0]);
+
+        // A different value is a new write with a fresh backoff
+        CHECK_EQUAL(0, sensor.requestThreshold(6));
+        CHECK_EQUAL(2, sensor.getWriteStats().writes);
+        uint32_t start = millis();
+        CHECK_EQUAL(1, run(sensor, simulator, MR24HPB1_WRITE_RETRY + 10, sentAt));
+        CHECK_EQUAL(start + MR24HPB1_WRITE_RETRY, sentAt[0]);
+    }
+
+    // Every echo lost: resent with the backoff doubling each time, then failed at the deadline
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(5);
+        simulator.setCorruption(1000);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        CHECK_EQUAL(0, sensor.requestThreshold(4));
+        uint32_t sentAt[MAX_SENDS];
+        CHECK_EQUAL(4, run(sensor, simulator, 2 * MR24HPB1_WRITE_DEADLINE, sentAt));
+        uint32_t backoff = MR24HPB1_WRITE_RETRY, expected = 0;
+        for (uint8_t i = 0; i < 4; i++, backoff *= 2)
+        {
+            expected += backoff;
+            CHECK_EQUAL(expected, sentAt[i]);
+        }
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_FAILED);
+        CHECK_EQUAL(MR24HPB1_WRITE_DEADLINE, millis());
+        CHECK_EQUAL(4, simulator.getThreshold()); // The sensor took it, only the echoes were lost
+        const write_stats_t &stats = sensor.getWriteStats();
+        CHECK_EQUAL(1, stats.writes);
+        CHECK_EQUAL(4, stats.retries);
+        CHECK_EQUAL(1, stats.failed);
+        CHECK_EQUAL(0, stats.confirmed);
+        CHECK(simulator.stats().framesCorrupted >= 5);
+
+        // The blocking call reports the same failure
+        CHECK_EQUAL(-2, sensor.setThreshold(5));
+        CHECK_EQUAL(2, sensor.getWriteStats().failed);
+    }
+
+    // An echo that gets through after a retry confirms it, the latency counting from the first send
+    {
+        Host::reset();
+        MR24HPB1::Simulator simulator(5);
+        simulator.setCorruption(1000);
+        MR24HPB1::MR24HPB1 sensor(simulator, S1_PIN, S2_PIN);
+        sensor.setWriteTimeouts(MR24HPB1_WRITE_DEADLINE, 20);
+        CHECK_EQUAL(0, sensor.requestThreshold(9));
+        CHECK_EQUAL(2, run(sensor, simulator, 70)); // Resent at 20 and 60
+        simulator.setCorruption(0);
+        CHECK_EQUAL(1, run(sensor, simulator, 100)); // Resent at 140, echoed intact
+        CHECK(sensor.getWriteState(CACHED_THRESHOLD) == WRITE_CONFIRMED);
+        CHECK_EQUAL(9, sensor.getThreshold());
+        const write_stats_t &stats = sensor.getWriteStats();
+        CHECK_EQUAL(3, stats.retries);
+        CHECK_EQUAL(1, stats.confirmed);
+        CHECK_EQUAL(140, stats.last_latency);
+        CHECK_EQUAL(140, stats.max_latency);
+        CHECK_EQUAL(140, stats.total_latency);
+
+        // A second write confirmed at once keeps the max and adds to the total
+        CHECK_EQUAL(0, sensor.setThreshold(3));
+        CHECK_EQUAL(2, sensor.getWriteStats().confirmed);
+        CHECK_EQUAL(140, sensor.getWriteStats().max_latency);
+        CHECK(sensor.getWriteStats().last_latency < 140);
+        CHECK_EQUAL(140 + sensor.getWriteStats().last_latency, sensor.getWriteStats().total_latency);
+    }
+    return checkResult();
+}
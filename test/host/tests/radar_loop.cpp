@@ -0,0 +1,70 @@
+/*
+ * MR24HPB1::Radar::loop(): frames split across calls, the frame budget and batches larger than the frame pool.
+ */
+#include "Radar/MR24HPB1/MR24HPB1.h"
+#include "check.h"
+
+using namespace MR24HPB1;
+
+static std::vector<uint8_t> environmentFrames(uint16_t count)
+{
+    std::vector<uint8_t> bytes;
+    uint8_t frame[MR24HPB1_MAX_FRAME_LENGTH];
+    for (uint16_t i = 0; i < count; i++)
+    {
+        // Stationary and exercising in turn, so the motion callback fires on every frame after the first
+        const uint8_t data[] = {0x01, (uint8_t)(i & 1), (uint8_t)(i & 1 ? 0x01 : 0xFF)};
+        uint8_t length = buildFrame(frame, PROACTIVE_REPORT, RADAR_INFO, ENVIRONMENTAL_STATUS, data, sizeof(data));
+        bytes.insert(bytes.end(), frame, frame + length);
+    }
+    return bytes;
+}
+
+int main()
+{
+    // A frame split across loop() calls is completed by the call that receives its last byte
+    {
+        HardwareSerial uart;
+        Radar radar(uart);
+        uint32_t motions = 0;
+        radar.registerMotionCallback([&](Motion::State) { motions++; });
+        std::vector<uint8_t> bytes = environmentFrames(6);
+        for (size_t position = 0; position < bytes.size(); position += 5)
+        {
+            uart.inject(&bytes[position], bytes.size() - position < 5 ? bytes.size() - position : 5);
+            radar.loop();
+        }
+        CHECK_EQUAL(6, motions);
+        CHECK_EQUAL(0, uart.available());
+    }
+
+    // More frames than the pool holds are received and processed in batches within one call
+    {
+        HardwareSerial uart;
+        Radar radar(uart);
+        uint32_t motions = 0;
+        radar.registerMotionCallback([&](Motion::State) { motions++; });
+        radar.setFrameBudget(255);
+        uart.inject(environmentFrames(MR24HPB1_FRAME_POOL_SIZE * 3 + 1));
+        radar.loop();
+        CHECK_EQUAL(MR24HPB1_FRAME_POOL_SIZE * 3 + 1, motions);
+    }
+
+    // The budget bounds each call, the remaining frames wait for the next one
+    {
+        HardwareSerial uart;
+        Radar radar(uart);
+        uint32_t motions = 0;
+        radar.registerMotionCallback([&](Motion::State) { motions++; });
+        radar.setFrameBudget(3);
+        uart.inject(environmentFrames(10));
+        radar.loop();
+        CHECK_EQUAL(3, motions);
+        radar.loop();
+        CHECK_EQUAL(6, motions);
+        radar.loop();
+        radar.loop();
+        CHECK_EQUAL(10, motions);
+    }
+    return checkResult();
+}
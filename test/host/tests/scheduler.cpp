@@ -0,0 +1,102 @@
+/*
+ * Scheduler wake sources on the host stand-ins: a UART with bytes waiting, an ISR queue filled by scheduled pin
+ * changes and the MR24HPB1 S1/S2 interrupts, wired the way the firmware wires them. Latency is timed from the
+ * micros() the ISRs stamp on each event.
+ */
+#include "Util/Scheduler.h"
+#include "Util/RingBuffer.h"
+#include "MR24HPB1Simulator.h"
+#include "check.h"
+
+#define EVENT_PIN 9
+#define S1_PIN 18
+#define S2_PIN 19
+#define IDLE_INTERVAL 1000
+
+struct PinEvent
+{
+    uint8_t level;
+    uint32_t timestamp;
+};
+RingBuffer<PinEvent, 8> pinEvents;
+
+int main()
+{
+    // A UART with bytes waiting runs only the task watching it, ahead of its deadline
+    {
+        Host::reset();
+        Scheduler scheduler;
+        HardwareSerial uart;
+        uint32_t uartRuns = 0, otherRuns = 0;
+        int8_t uartTask = scheduler.add([&]() { uartRuns++; while (uart.read() >= 0) {} return (uint32_t)IDLE_INTERVAL; });
+        scheduler.add([&]() { otherRuns++; return (uint32_t)IDLE_INTERVAL; });
+        CHECK(scheduler.watch(uart, uartTask));
+        scheduler.runDue(); // Both run at their first deadline
+        const uint8_t bytes[] = {0x55, 0x01};
+        uart.inject(bytes, sizeof(bytes));
+        scheduler.runDue();
+        CHECK_EQUAL(2, uartRuns);
+        CHECK_EQUAL(1, otherRuns);
+    }
+
+    // An edge mid-sleep is noticed within one sleep step and timed from its ISR
+    {
+        Host::reset();
+        Scheduler scheduler;
+        uint32_t drained = 0;
+        attachInterrupt(EVENT_PIN, []() { pinEvents.push(PinEvent{(uint8_t)digitalRead(EVENT_PIN), micros()}); }, CHANGE);
+        int8_t drainTask = scheduler.add([&]() {
+            PinEvent event;
+            while (pinEvents.pop(event))
+            {
+                drained++;
+                scheduler.handled(event.timestamp);
+            }
+            return (uint32_t)IDLE_INTERVAL;
+        });
+        CHECK(scheduler.watch([]() { return !pinEvents.empty(); }, drainTask));
+        Host::schedulePin(EVENT_PIN, HIGH, 20350);
+        Host::schedulePin(EVENT_PIN, LOW, 41999);
+        while (micros() < 60000)
+        {
+            scheduler.run();
+        }
+        CHECK_EQUAL(2, drained);
+        CHECK_EQUAL(2, scheduler.stats().handled);
+        CHECK_EQUAL(2, scheduler.stats().wakes);
+        CHECK(scheduler.stats().maxLatency > 0);
+        CHECK(scheduler.stats().maxLatency <= SCHEDULER_SLEEP_STEP * 1000);
+        CHECK_EQUAL(1, scheduler.stats().lastLatency); // 41999 us noticed at the 42 ms step
+    }
+
+    // S1/S2 edges queued by the MR24HPB1 interrupts wake the radar task, timed from getLastEdgeMicros()
+    {
+        Host::reset();
+        Scheduler scheduler;
+        MR24HPB1::Simulator simulator;
+        MR24HPB1::MR24HPB1 radar(simulator, S1_PIN, S2_PIN);
+        CHECK(radar.attachPinInterrupts());
+        uint32_t occupied = 0, lastEdge = 0;
+        radar.register_on_occupied([&]() { occupied++; });
+        int8_t radarTask = scheduler.add([&]() {
+            radar.refresh();
+            if (radar.getLastEdgeMicros() != lastEdge)
+            {
+                lastEdge = radar.getLastEdgeMicros();
+                scheduler.handled(lastEdge);
+            }
+            return (uint32_t)IDLE_INTERVAL;
+        });
+        CHECK(scheduler.watch([&]() { return radar.pinEdgesPending(); }, radarTask));
+        Host::schedulePin(S1_PIN, HIGH, 5500);
+        while (micros() < 10000)
+        {
+            scheduler.run();
+        }
+        CHECK_EQUAL(1, occupied);
+        CHECK_EQUAL(5500, radar.getLastEdgeMicros());
+        CHECK_EQUAL(1, scheduler.stats().handled);
+        CHECK_EQUAL(500, scheduler.stats().lastLatency);
+    }
+    return checkResult();
+}
@@ -0,0 +1,116 @@
+/*
+ * Plays a capture log from Capture::drain() through a driver and prints what it decoded.
+ *   replay <capture file> <ld2410|mr24hpb1> [fast|timed]
+ * fast hands the driver every byte at once. timed releases them at their recorded gaps on the shim's clock, which
+ * the tool steps in 100 us increments, so it still runs faster than real time.
+ */
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Util/Capture.h"
+#include "Radar/LD2410/LD2410.h"
+#include "Radar/MR24HPB1/MR24HPB1.h"
+
+#define REPLAY_STEP_MICROS 100
+
+static bool load(const char *path, std::vector<uint8_t> &bytes)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        bytes.insert(bytes.end(), chunk, chunk + length);
+    }
+    fclose(file);
+    return true;
+}
+
+// Run step until the replay has delivered everything, advancing the clock in timed mode
+template <typename Step>
+static uint32_t play(CaptureReplay &replay, CaptureReplay::Mode mode, Step step)
+{
+    uint32_t steps = 0;
+    while (!replay.finished())
+    {
+        step();
+        if (mode == CaptureReplay::ORIGINAL_TIMING)
+        {
+            Host::advanceMicros(REPLAY_STEP_MICROS);
+        }
+        steps++;
+    }
+    step(); // Whatever the last bytes completed
+    return steps;
+}
+
+static void playLD2410(CaptureReplay &replay, CaptureReplay::Mode mode)
+{
+    LD2410 radar(replay);
+    uint32_t frames = 0;
+    int8_t presence = -1;
+    play(replay, mode, [&]() {
+        frames += radar.read();
+        if (radar.presenceDetected() != presence)
+        {
+            presence = radar.presenceDetected();
+            printf("%10lu us  %s, moving %u cm, stationary %u cm\n", (unsigned long)micros(), presence ? "present" : "absent",
+                   radar.getMovingTargetDistance(), radar.getStationaryTargetDistance());
+        }
+    });
+    printf("%lu frames decoded\n", (unsigned long)frames);
+}
+
+static void playMR24HPB1(CaptureReplay &replay, CaptureReplay::Mode mode)
+{
+    MR24HPB1::MR24HPB1 sensor(replay, 0, 1);
+    uint32_t states = 0;
+    sensor.register_on_environmental_state([&](uint8_t state) {
+        states++;
+        printf("%10lu us  environment %s\n", (unsigned long)micros(), state == UNOCCUPIED ? "unoccupied" : state == STATIONARY ? "stationary" : "exercising");
+    });
+    sensor.register_on_away_state([](uint8_t state) { printf("%10lu us  approach/away %u\n", (unsigned long)micros(), state); });
+    play(replay, mode, [&]() { sensor.refresh(); });
+    printf("%lu environment reports\n", (unsigned long)states);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3 || (strcmp(argv[2], "ld2410") != 0 && strcmp(argv[2], "mr24hpb1") != 0))
+    {
+        fprintf(stderr, "usage: %s <capture file> <ld2410|mr24hpb1> [fast|timed]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> log;
+    if (!load(argv[1], log))
+    {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    CaptureReplay::Mode mode = argc > 3 && strcmp(argv[3], "timed") == 0 ? CaptureReplay::ORIGINAL_TIMING : CaptureReplay::FAST;
+    CaptureReplay replay(log.data(), log.size(), mode);
+    if (!replay.valid())
+    {
+        fprintf(stderr, "%s is not a capture log\n", argv[1]);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (strcmp(argv[2], "ld2410") == 0)
+    {
+        playLD2410(replay, mode);
+    }
+    else
+    {
+        playMR24HPB1(replay, mode);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%lu bytes from the sensor, %lu written by the driver, %lu lost in capture\n", (unsigned long)replay.stats().delivered,
+           (unsigned long)replay.stats().written, (unsigned long)replay.stats().dropped);
+    printf("%.3f ms, %.1f MB/s\n", seconds * 1000, seconds > 0 ? replay.stats().delivered / seconds / 1e6 : 0.0);
+    return 0;
+}
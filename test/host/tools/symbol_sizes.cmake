@@ -0,0 +1,24 @@
+# Sums the sizes of the symbols matching PATTERN in OBJECTS, as nm reports them.
+#   cmake -DNM=nm -DOBJECTS="a.o;b.o" -DPATTERN=regex -DLABEL=name -P symbol_sizes.cmake
+cmake_policy(SET CMP0057 NEW)
+execute_process(COMMAND ${NM} --defined-only --print-size --demangle ${OBJECTS} OUTPUT_VARIABLE symbols RESULT_VARIABLE failed)
+if(failed)
+    message(FATAL_ERROR "${NM} failed on ${OBJECTS}")
+endif()
+string(REPLACE "\n" ";" symbols "${symbols}")
+set(total 0)
+set(seen "")
+foreach(line IN LISTS symbols)
+    # address size type name
+    if(line MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) [tTrRdDu] (.*)$")
+        set(name "${CMAKE_MATCH_2}")
+        math(EXPR size "0x${CMAKE_MATCH_1}")
+        # Inline variables and templates appear once per object; the linker keeps one
+        if(name MATCHES "${PATTERN}" AND NOT name IN_LIST seen)
+            list(APPEND seen "${name}")
+            math(EXPR total "${total} + ${size}")
+            message(STATUS "${LABEL}: ${size} ${name}")
+        endif()
+    endif()
+endforeach()
+message(STATUS "${LABEL}: ${total} bytes")